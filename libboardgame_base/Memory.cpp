@@ -6,17 +6,47 @@
 
 #include "Memory.h"
 
+#include <cstdlib>
 #ifdef _WIN32
 #include <algorithm>
 #include <windows.h>
 #else
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#endif
 
 namespace libboardgame_base {
 
 //-----------------------------------------------------------------------------
 
+void* alloc_large(size_t size, bool& is_huge_page_advised)
+{
+    is_huge_page_advised = false;
+#ifdef __linux__
+    const size_t huge_page_size = 2 * 1024 * 1024;
+    if (size < huge_page_size)
+        return malloc(size);
+    // aligned_alloc() requires the size to be a multiple of the alignment
+    size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void* p = aligned_alloc(huge_page_size, size);
+    if (p == nullptr)
+        return nullptr;
+    // madvise() also succeeds if transparent huge pages are disabled
+    std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string enabled;
+    if (getline(in, enabled) && enabled.find("[never]") == std::string::npos
+            && madvise(p, size, MADV_HUGEPAGE) == 0)
+        is_huge_page_advised = true;
+    return p;
+#else
+    return malloc(size);
+#endif
+}
+
 size_t get_memory()
 {
 #ifdef _WIN32
@@ -17,6 +17,19 @@ namespace libboardgame_base {
     @return The memory in bytes or 0 if the memory could not be determined. */
 std::size_t get_memory();
 
+/** Allocate a large block of memory that is accessed randomly.
+    The memory is not initialized, so its pages are only mapped when they are
+    first written. On Linux, the block is aligned to the size of a huge page
+    and the kernel is advised to back it with transparent huge pages, which
+    reduces TLB misses. The block must be freed with std::free().
+    @param size The size in bytes.
+    @param[out] is_huge_page_advised Set to true if transparent huge pages
+    are enabled and the advice was accepted. This does not mean that the
+    kernel will back the block with huge pages, which depends on the
+    available memory when the pages are mapped.
+    @return The block or nullptr if the allocation failed. */
+void* alloc_large(std::size_t size, bool& is_huge_page_advised);
+
 //-----------------------------------------------------------------------------
 
 } // namespace libboardgame_base
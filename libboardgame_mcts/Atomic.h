@@ -57,6 +57,19 @@ struct Atomic<T, false>
         val += t;
         return tmp;
     }
+
+    bool compare_exchange_weak(
+            T& expected, T desired,
+            [[maybe_unused]] memory_order order = memory_order_seq_cst)
+    {
+        if (val != expected)
+        {
+            expected = val;
+            return false;
+        }
+        val = desired;
+        return true;
+    }
 };
 
 template<typename T>
@@ -89,6 +102,12 @@ struct Atomic<T, true>
     {
         return val.fetch_add(t);
     }
+
+    bool compare_exchange_weak(T& expected, T desired,
+                               memory_order order = memory_order_seq_cst)
+    {
+        return val.compare_exchange_weak(expected, desired, order);
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -19,6 +19,31 @@ using NodeIdx = uint_least32_t;
 
 //-----------------------------------------------------------------------------
 
+/** Game-theoretic result of a node proven by the search.
+    See SearchParamConstDefault::use_solver. */
+enum class ProvenResult : signed char
+{
+    none,
+
+    loss,
+
+    draw,
+
+    win
+};
+
+/** Get the result from the point of view of the opponent. */
+inline ProvenResult get_inverse(ProvenResult result)
+{
+    if (result == ProvenResult::win)
+        return ProvenResult::loss;
+    if (result == ProvenResult::loss)
+        return ProvenResult::win;
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+
 /** %Node in a MCTS tree.
     For details about how the nodes are used in lock-free multi-threaded mode,
     see M. Enzenberger, M. Mueller: A Lock-free Multithreaded Monte-Carlo Tree
@@ -78,6 +103,38 @@ public:
         of view of the player at the parent node. */
     Float get_value() const;
 
+    /** Game-theoretic result of the node if proven by the search.
+        The point of view is the same as in get_value(). */
+    ProvenResult get_proven() const;
+
+    void set_proven(ProvenResult result);
+
+    /** Were the children generated for all legal moves?
+        If not, the node cannot be proven by proving all of its children. Set
+        when the node is expanded. */
+    bool has_all_moves() const;
+
+    void set_has_all_moves(bool enable);
+
+    /** Were the children generated only for a part of the moves?
+        Used for progressive widening, see
+        SearchParamConstDefault::widening_nu_children. Set when the node is
+        expanded. Also true while a thread is creating more children of the
+        node. */
+    bool is_partially_expanded() const;
+
+    /** Set or clear the partially expanded state.
+        Also ends the state started with start_widening(). */
+    void set_partially_expanded(bool enable);
+
+    /** Start creating more children of a partially expanded node.
+        Uses compare-and-swap, so that only one thread succeeds if several
+        threads try to widen the node at the same time. The thread must end
+        the widening with set_partially_expanded().
+        @return false if the node is not partially expanded or another thread
+        is already widening it. */
+    bool start_widening();
+
     bool is_unexpanded() const { return get_nu_children() == value_unexpanded; }
 
     void set_expanding();
@@ -94,6 +151,21 @@ public:
         search. */
     void copy_data_from(const Node& node);
 
+    /** Copy the data and the child information from a node in the tree.
+        Used for replacing the children of a node by a larger number of
+        children during the search. Nodes that are currently expanding are
+        copied as unexpanded, nodes that are currently widened as partially
+        expanded. This function may not be called on a node that is already
+        part of the tree in multi-threaded mode. */
+    void copy_from(const Node& node);
+
+    /** Set the data of the node without changing the child information.
+        Used for restoring a tree written with Tree::write(). This function is
+        not thread-safe and may not be called during the search. */
+    void set_data(const Move& mv, Float value, Float value_count,
+                  Float visit_count, Float move_prior, ProvenResult proven,
+                  bool has_all_moves, bool is_partially_expanded);
+
     void link_children(NodeIdx first_child, unsigned nu_children);
 
     /** Faster version of link_children() for single-threaded parts of the
@@ -101,7 +173,8 @@ public:
     void link_children_st(NodeIdx first_child, unsigned nu_children);
 
     /** Unlink children.
-        Only to be used in single-threaded parts of the code. */
+        Also clears the partially expanded state. Only to be used in
+        single-threaded parts of the code. */
     void unlink_children_st();
 
     void add_value(Float v, Float weight = 1);
@@ -113,6 +186,21 @@ public:
 
     void inc_visit_count();
 
+    /** Version of add_value() that does not lose updates in multi-threaded
+        mode.
+        Uses compare-and-swap loops for the count and the value. Each caller
+        gets a unique count, so the result can differ from a sequential
+        update only by the order in which the values are added. */
+    void add_value_atomic(Float v, Float weight = 1);
+
+    /** Version of add_value_remove_loss() that does not lose updates in
+        multi-threaded mode. */
+    void add_value_remove_loss_atomic(Float v);
+
+    /** Version of inc_visit_count() that does not lose updates in
+        multi-threaded mode. */
+    void inc_visit_count_atomic();
+
     /** Get node index of first child.
         @pre get_nu_children() > 0. Note that in lock-free search, it can
         happen that get_nu_children() was greater 0 but becomes negative
@@ -125,6 +213,17 @@ public:
     NodeIdx get_first_child() const;
 
 private:
+    /** Progressive widening state, see is_partially_expanded() */
+    enum class Widening : signed char
+    {
+        none,
+
+        partial,
+
+        /** A thread is creating more children, see start_widening() */
+        started
+    };
+
     Atomic<Float, MT> m_value;
 
     Atomic<Float, MT> m_value_count;
@@ -138,6 +237,15 @@ private:
 
     Move m_move;
 
+    /** See get_proven() */
+    Atomic<ProvenResult, MT> m_proven;
+
+    /** See has_all_moves() */
+    Atomic<bool, MT> m_has_all_moves;
+
+    /** See is_partially_expanded() */
+    Atomic<Widening, MT> m_widening;
+
     Atomic<NodeIdx, MT> m_first_child;
 };
 
@@ -167,6 +275,33 @@ void Node<M, F, MT>::add_value_remove_loss(Float v)
     m_value.store(value, memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+void Node<M, F, MT>::add_value_atomic(Float v, Float weight)
+{
+    Float count = m_value_count.load(memory_order_relaxed);
+    while (! m_value_count.compare_exchange_weak(count, count + weight,
+                                                 memory_order_relaxed))
+        ;
+    count += weight;
+    Float value = m_value.load(memory_order_relaxed);
+    while (! m_value.compare_exchange_weak(
+               value, value + weight * (v - value) / count,
+               memory_order_relaxed))
+        ;
+}
+
+template<typename M, typename F, bool MT>
+void Node<M, F, MT>::add_value_remove_loss_atomic(Float v)
+{
+    Float count = m_value_count.load(memory_order_relaxed);
+    if (count == 0)
+        return; // Adding the virtual loss was not done atomically
+    Float value = m_value.load(memory_order_relaxed);
+    while (! m_value.compare_exchange_weak(value, value + v / count,
+                                           memory_order_relaxed))
+        ;
+}
+
 template<typename M, typename F, bool MT>
 void Node<M, F, MT>::copy_data_from(const Node& node)
 {
@@ -179,6 +314,9 @@ void Node<M, F, MT>::copy_data_from(const Node& node)
         Float m_move_prior;
         Atomic<short, MT> m_nu_children;
         Move m_move;
+        Atomic<ProvenResult, MT> m_proven;
+        Atomic<bool, MT> m_has_all_moves;
+        Atomic<Widening, MT> m_widening;
         NodeIdx m_first_child;
     };
     static_assert(sizeof(Node) == sizeof(Dummy));
@@ -193,6 +331,31 @@ void Node<M, F, MT>::copy_data_from(const Node& node)
                   memory_order_relaxed);
     m_visit_count.store(node.m_visit_count.load(memory_order_relaxed),
                         memory_order_relaxed);
+    m_proven.store(node.m_proven.load(memory_order_relaxed),
+                   memory_order_relaxed);
+    m_has_all_moves.store(node.m_has_all_moves.load(memory_order_relaxed),
+                          memory_order_relaxed);
+    m_widening.store(node.m_widening.load(memory_order_relaxed),
+                     memory_order_relaxed);
+}
+
+template<typename M, typename F, bool MT>
+void Node<M, F, MT>::copy_from(const Node& node)
+{
+    copy_data_from(node);
+    if (m_widening.load(memory_order_relaxed) == Widening::started)
+        // The other thread links the new children to the old node
+        m_widening.store(Widening::partial, memory_order_relaxed);
+    // Any value greater 0 is consistent with the first child, see
+    // get_first_child()
+    auto nu_children = node.get_nu_children();
+    if (nu_children > 0)
+        link_children_st(node.get_first_child(),
+                         static_cast<unsigned>(nu_children));
+    else if (nu_children == 0)
+        link_children(0, 0);
+    else
+        unlink_children_st();
 }
 
 template<typename M, typename F, bool MT>
@@ -219,12 +382,30 @@ inline auto Node<M, F, MT>::get_value() const -> Float
     return m_value.load(memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+inline ProvenResult Node<M, F, MT>::get_proven() const
+{
+    return m_proven.load(memory_order_relaxed);
+}
+
 template<typename M, typename F, bool MT>
 inline auto Node<M, F, MT>::get_visit_count() const -> Float
 {
     return m_visit_count.load(memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+inline bool Node<M, F, MT>::has_all_moves() const
+{
+    return m_has_all_moves.load(memory_order_relaxed);
+}
+
+template<typename M, typename F, bool MT>
+inline bool Node<M, F, MT>::is_partially_expanded() const
+{
+    return m_widening.load(memory_order_relaxed) != Widening::none;
+}
+
 template<typename M, typename F, bool MT>
 inline void Node<M, F, MT>::inc_visit_count()
 {
@@ -235,6 +416,15 @@ inline void Node<M, F, MT>::inc_visit_count()
     m_visit_count.store(count, memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+inline void Node<M, F, MT>::inc_visit_count_atomic()
+{
+    Float count = m_visit_count.load(memory_order_relaxed);
+    while (! m_visit_count.compare_exchange_weak(count, count + 1,
+                                                 memory_order_relaxed))
+        ;
+}
+
 template<typename M, typename F, bool MT>
 void Node<M, F, MT>::init(const Move& mv, Float value, Float count,
                           Float move_prior)
@@ -249,6 +439,9 @@ void Node<M, F, MT>::init(const Move& mv, Float value, Float count,
     m_value_count.store(count, memory_order_relaxed);
     m_value.store(value, memory_order_relaxed);
     m_visit_count.store(0, memory_order_relaxed);
+    m_proven.store(ProvenResult::none, memory_order_relaxed);
+    m_has_all_moves.store(false, memory_order_relaxed);
+    m_widening.store(Widening::none, memory_order_relaxed);
     m_nu_children.store(value_unexpanded, memory_order_relaxed);
 }
 
@@ -259,6 +452,9 @@ void Node<M, F, MT>::init_root()
     m_move = Move::null();
 #endif
     m_visit_count.store(0, memory_order_relaxed);
+    m_proven.store(ProvenResult::none, memory_order_relaxed);
+    m_has_all_moves.store(false, memory_order_relaxed);
+    m_widening.store(Widening::none, memory_order_relaxed);
     m_nu_children.store(value_unexpanded, memory_order_relaxed);
 }
 
@@ -269,7 +465,8 @@ inline void Node<M, F, MT>::link_children(NodeIdx first_child,
     LIBBOARDGAME_ASSERT(nu_children < max_children);
     LIBBOARDGAME_ASSERT(nu_children < Move::range);
     // first_child cannot be 0 because 0 is always used for the root node
-    LIBBOARDGAME_ASSERT(first_child != 0);
+    // (unless there are no children)
+    LIBBOARDGAME_ASSERT(first_child != 0 || nu_children == 0);
     // Note that we need release/acquire order for both m_nu_children and
     // m_first_child because because the lock-free search cannot guarantee that
     // a node is not expanded by two threads simultaneously (even if it tries
@@ -294,17 +491,68 @@ inline void Node<M, F, MT>::link_children_st(NodeIdx first_child,
     m_nu_children.store(static_cast<short>(nu_children), memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+inline void Node<M, F, MT>::set_has_all_moves(bool enable)
+{
+    m_has_all_moves.store(enable, memory_order_relaxed);
+}
+
+template<typename M, typename F, bool MT>
+void Node<M, F, MT>::set_data(const Move& mv, Float value, Float value_count,
+                              Float visit_count, Float move_prior,
+                              ProvenResult proven, bool has_all_moves,
+                              bool is_partially_expanded)
+{
+    m_move = mv;
+    m_move_prior = move_prior;
+    m_value_count.store(value_count, memory_order_relaxed);
+    m_value.store(value, memory_order_relaxed);
+    m_visit_count.store(visit_count, memory_order_relaxed);
+    m_proven.store(proven, memory_order_relaxed);
+    m_has_all_moves.store(has_all_moves, memory_order_relaxed);
+    m_widening.store(is_partially_expanded ? Widening::partial
+                                           : Widening::none,
+                     memory_order_relaxed);
+}
+
 template<typename M, typename F, bool MT>
 void Node<M, F, MT>::set_expanding()
 {
     m_nu_children.store(value_expanding, memory_order_relaxed);
 }
 
+template<typename M, typename F, bool MT>
+inline void Node<M, F, MT>::set_partially_expanded(bool enable)
+{
+    // Release order, such that a thread that starts widening the node with
+    // start_widening() sees the children linked before
+    m_widening.store(enable ? Widening::partial : Widening::none,
+                     memory_order_release);
+}
+template<typename M, typename F, bool MT>
+inline void Node<M, F, MT>::set_proven(ProvenResult result)
+{
+    // Store relaxed, the result of a node never changes once it is proven
+    // and a lost update only delays the proof
+    m_proven.store(result, memory_order_relaxed);
+}
+
+template<typename M, typename F, bool MT>
+bool Node<M, F, MT>::start_widening()
+{
+    auto widening = Widening::partial;
+    while (! m_widening.compare_exchange_weak(widening, Widening::started,
+                                              memory_order_acquire))
+        if (widening != Widening::partial)
+            return false;
+    return true;
+}
 template<typename M, typename F, bool MT>
 inline void Node<M, F, MT>::unlink_children_st()
 {
     // Store relaxed (wouldn't even need to be atomic)
     m_nu_children.store(value_unexpanded, memory_order_relaxed);
+    m_widening.store(Widening::none, memory_order_relaxed);
 }
 
 //-----------------------------------------------------------------------------
@@ -8,13 +8,14 @@
 #define LIBBOARDGAME_MCTS_SEARCH_BASE_H
 
 #include <array>
-#include <condition_variable>
 #include <functional>
-#include <mutex>
-#include <thread>
+#include <type_traits>
 #include "Atomic.h"
 #include "LastGoodReply.h"
 #include "PlayerMove.h"
+#include "SelectChild.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
 #include "Tree.h"
 #include "TreeUtil.h"
 #include "libboardgame_base/ArrayList.h"
@@ -89,10 +90,44 @@ struct SearchParamConstDefault
         Must be greater 0 if use_lgr is true. */
     static constexpr size_t lgr_hash_table_size = 0;
 
+    /** Maximum depth of nodes that are updated without lost updates.
+        In multi-threaded mode, the values and counts of nodes are updated
+        without synchronization, which can lose updates if several threads
+        update the same node. This is rare apart from nodes close to the
+        root, which are visited by every simulation. Nodes up to this depth
+        (root has depth 0) are updated with compare-and-swap loops instead,
+        which makes their statistics exact at the cost of retries under
+        contention. The value 0 applies this only to the visit count of the
+        root. Only used if multithread is true. */
+    static constexpr unsigned atomic_update_depth = 0;
+
     /** Use virtual loss in multi-threaded mode.
         See Chaslot et al.: Parallel Monte-Carlo Tree Search. 2008. */
     static constexpr bool virtual_loss = false;
 
+    /** Compile with support for transpositions.
+        If true, the state must provide a function get_hash() that returns a
+        64-bit hash of the current position in the in-tree phase. The hash
+        must include all information that determines the moves generated by
+        gen_children() and the player to play. Transpositions still need to be
+        enabled at runtime with SearchBase::set_use_transpositions(). */
+    static constexpr bool use_transpositions = false;
+
+    /** Compile with support for proving game-theoretic results.
+        Terminal positions in the tree with an exact result are marked as
+        proven and the results are propagated to the parents like in
+        MCTS-Solver (see M. Winands, Y. Bjoernsson, J. Saito: Monte-Carlo Tree
+        Search Solver. Computers and Games 2008). A node is proven if it has a
+        child that is a proven win for the player to play, or if all of its
+        children are proven and they were generated for all legal moves.
+        select_final() prefers proven wins and the search terminates when the
+        root is proven. The solver is only used if get_nu_players() is 2.
+        If true, the state must provide the functions
+        ProvenResult get_proven_result(PlayerInt player) for terminal positions
+        in the in-tree phase and bool has_all_moves(), which returns if the
+        last call of gen_children() generated all legal moves. */
+    static constexpr bool use_solver = false;
+
     /** The minimum count used in prior knowledge initialization of
         the children of an expanded node.
         The value must be greater 0 (it may be a positive epsilon) because
@@ -117,6 +152,24 @@ struct SearchParamConstDefault
     /** Increase of the expansion threshold per in-tree move played. */
     static constexpr Float expansion_threshold_inc = 0;
 
+    /** Maximum number of children created at a node expansion.
+        If greater 0, progressive widening is used: if a node other than the
+        root is expanded, only the children with the highest move priors are
+        created. The number of children of such a node is doubled whenever
+        its visit count reaches widening_visit_ratio times its number of
+        children. This saves memory in games with many legal moves, most of
+        which are never visited. The missing children are created by calling
+        finish_in_tree() and gen_children() again in the in-tree phase, so the
+        state must allow playing further in-tree moves after that and must
+        generate the same children for the same position. The node gets a new
+        block of children with copies of the existing children, the old block
+        stays unused in the tree until the next prune(). Children of partially
+        expanded nodes are not shared by transpositions. */
+    static constexpr unsigned widening_nu_children = 0;
+
+    /** See widening_nu_children. */
+    static constexpr Float widening_visit_ratio = 1;
+
     /** Expected simulations per second.
         If the simulations per second vary a lot, it should be a value closer
         to the lower values. This value is used, for example, to determine an
@@ -194,7 +247,7 @@ public:
 
     /** Constructor.
         @param nu_threads
-        @param memory The memory to be used for (all) the search trees. */
+        @param memory The memory to be used for the search tree. */
     SearchBase(unsigned nu_threads, size_t memory);
 
     virtual ~SearchBase();
@@ -282,6 +335,16 @@ public:
 
     Float get_rave_weight() const;
 
+    /** Share the children of nodes with identical positions.
+        Positions that are reached by different move sequences share their
+        children and thereby their statistics, which makes the tree a directed
+        acyclic graph. Requires SearchParamConst::use_transpositions. Changing
+        this parameter discards the tree of the last search. Default is
+        false. */
+    void set_use_transpositions(bool enable);
+
+    bool get_use_transpositions() const { return m_use_transpositions; }
+
     /** @} */ // @name
 
 
@@ -338,22 +401,49 @@ public:
         of a subtree reused from the previous search. */
     Float get_root_visit_count() const;
 
-    /** Abort a running search before the time limit or maximum number
-        of simulations is reached. */
+    /** Abort a running or the next search before the time limit or maximum
+        number of simulations is reached.
+        May be called from a different thread. The abort is not reset by
+        search(), so an abort that arrives before search() starts is not lost.
+        @see clear_abort() */
     void abort() { m_abort = true; }
 
+    /** Reset the abort flag.
+        Must be called by the caller when it sets up a new search(), before
+        abort() can be called for it. */
+    void clear_abort() { m_abort = false; }
+
     /** Was the last search aborted? */
-    bool was_aborted() const { return m_abort; }
+    bool was_aborted() const { return m_was_aborted; }
 
-    /** Create the threads used in the search.
+    /** Create the thread states used in the search.
         This cannot be done in the constructor because it uses the virtual
         function create_state(). This function will automatically be called
-        before a search if the threads have not been constructed yet, but it
-        is advisable to explicitly call it in the constructor of the subclass
-        to save some time at the first move generation where the game clock
-        might already be running. */
+        before a search if the thread states have not been constructed yet,
+        but it is advisable to explicitly call it in the constructor of the
+        subclass to save some time at the first move generation where the game
+        clock might already be running. The search threads are taken from
+        ThreadPool::get_global(), which is extended if it has not enough
+        threads. */
     void create_threads();
 
+    /** Write the tree and root evaluation of the last search.
+        The tree is written in the format of Tree::write(). Subclasses need
+        to write the position of the last search themselves if they want to
+        restore it. */
+    void write_tree(ostream& out) const;
+
+    /** Read a tree and root evaluation written with write_tree().
+        The next search reuses the tree if its position is the position of
+        the last search (independent of set_reuse_tree()) or a followup
+        position (if set_reuse_subtree() is enabled), so that a long analysis
+        can be continued.
+        @param in
+        @param is_valid_move See Tree::read()
+        @throws runtime_error if the stream has an invalid format. */
+    void read_tree(istream& in,
+                   const function<bool(const Move&)>& is_valid_move = {});
+
 protected:
     struct Simulation
     {
@@ -392,6 +482,9 @@ private:
             was full? */
         bool is_out_of_mem;
 
+        /** Value of m_nu_widenings at the start of the current simulation. */
+        size_t nu_widenings;
+
         Simulation simulation;
 
         StatisticsExt<> stat_len;
@@ -403,63 +496,11 @@ private:
         array<PlayerInt, Move::range> was_played;
 
         /** Local variable for update_rave().
-            Reused for efficiency. */
-        array<unsigned, Move::range> first_play;
+            Reused for efficiency. The move indices of a simulation fit into
+            16 bits, which keeps the array small enough for the cache. */
+        array<uint_least16_t, Move::range> first_play;
     };
 
-    /** Thread in the parallel search.
-        The thread waits for a call to start_search(), then runs
-        SearchBase::search_loop()) with the thread-specific search state.
-        After start_search(), wait_search_finished() needs to called before
-        calling start_search() again or destructing this object. */
-    class Thread
-    {
-    public:
-        using SearchFunc = function<void(ThreadState&)>;
-
-
-        ThreadState thread_state;
-
-        explicit Thread(SearchFunc& search_func);
-
-        ~Thread();
-
-        void run();
-
-        void start_search();
-
-        void wait_search_finished();
-
-    private:
-        SearchFunc m_search_func;
-
-        bool m_quit = false;
-
-        bool m_thread_ready_flag = false;
-
-        bool m_start_search_flag = false;
-
-        bool m_search_finished_flag = false;
-
-        mutex m_thread_ready_mutex;
-
-        mutex m_start_search_mutex;
-
-        mutex m_search_finished_mutex;
-
-        condition_variable m_thread_ready_cond;
-
-        condition_variable m_start_search_cond;
-
-        condition_variable m_search_finished_cond;
-
-        unique_lock<mutex> m_search_finished_lock{m_search_finished_mutex,
-                                                  defer_lock};
-
-        thread m_thread;
-
-        void thread_main();
-    };
 
 
     /** @name Members that are used concurrently by all threads during the
@@ -476,6 +517,18 @@ private:
     /** See get_nu_simulations(). */
     Atomic<size_t, multithread> m_nu_simulations;
 
+    /** Only used if m_use_transpositions. */
+    TranspositionTable<multithread> m_transposition_table;
+
+    /** Number of node expansions that reused the children of a
+        transposition. */
+    Atomic<size_t, multithread> m_nu_transpositions;
+
+    /** Number of calls of widen_node() that replaced the children of a
+        node.
+        See find_copied_nodes(). */
+    Atomic<size_t, multithread> m_nu_widenings;
+
     /** @} */ // @name
 
 
@@ -487,6 +540,15 @@ private:
 
     bool m_reuse_tree = false;
 
+    /** Was the tree read with read_tree() after the last search? */
+    bool m_is_tree_read = false;
+
+    bool m_use_transpositions = false;
+
+    /** Is the solver used in the current search?
+        See SearchParamConst::use_solver */
+    bool m_use_solver = false;
+
     /** Player to play at the root node of the search. */
     PlayerInt m_player;
 
@@ -499,6 +561,9 @@ private:
 
     atomic<bool> m_abort = false;
 
+    /** Value of m_abort at the end of the last search. */
+    bool m_was_aborted = false;
+
     Float m_rave_parent_max = 50000;
 
     Float m_rave_child_max = 2000;
@@ -524,9 +589,12 @@ private:
 
     Timer m_timer;
 
-    vector<unique_ptr<Thread>> m_threads;
+    vector<unique_ptr<ThreadState>> m_thread_states;
 
-    Tree m_tmp_tree;
+    /** Set when the search loop of any thread has finished.
+        Used to skip the search loop of threads that the thread pool started
+        only after the search was already finished. */
+    atomic<bool> m_search_loop_finished = false;
 
 #ifdef LIBBOARDGAME_DEBUG
     AssertionHandler m_assertion_handler;
@@ -550,6 +618,11 @@ private:
     bool expand_node(ThreadState& thread_state, const Node& node,
                      const Node*& best_child);
 
+    /** Get the result of a node proven by its children.
+        @return The result from the point of view of the player to play at
+        the node or ProvenResult::none if the node cannot be proven yet. */
+    ProvenResult get_proven_from_children(const Node& node) const;
+
     void playout(ThreadState& thread_state);
 
     void play_in_tree(ThreadState& thread_state);
@@ -559,6 +632,9 @@ private:
 
     void search_loop(ThreadState& thread_state);
 
+    /** Run search_loop() in parallel with the thread pool. */
+    void run_search_loops(unsigned nu_threads);
+
     const Node* select_child(const Node& node,
                              const typename Tree::Children& children);
 
@@ -566,84 +642,25 @@ private:
 
     void update_rave(ThreadState& thread_state);
 
-    void update_values(ThreadState& thread_state);
-};
-
-
-template<class S, class M, class R>
-SearchBase<S, M, R>::Thread::Thread(SearchFunc& search_func)
-    : m_search_func(search_func)
-{ }
-
-template<class S, class M, class R>
-SearchBase<S, M, R>::Thread::~Thread()
-{
-    if (! m_thread.joinable())
-        return;
-    m_quit = true;
-    {
-        lock_guard lock(m_start_search_mutex);
-        m_start_search_flag = true;
-    }
-    m_start_search_cond.notify_one();
-    m_thread.join();
-}
-
-template<class S, class M, class R>
-void SearchBase<S, M, R>::Thread::run()
-{
-    unique_lock<mutex> lock(m_thread_ready_mutex);
-    m_thread = thread(bind(&Thread::thread_main, this));
-    while (! m_thread_ready_flag)
-        m_thread_ready_cond.wait(lock);
-}
-
-template<class S, class M, class R>
-void SearchBase<S, M, R>::Thread::start_search()
-{
-    LIBBOARDGAME_ASSERT(m_thread.joinable());
-    m_search_finished_lock.lock();
-    {
-        lock_guard lock(m_start_search_mutex);
-        m_start_search_flag = true;
-    }
-    m_start_search_cond.notify_one();
-}
+    void update_proven(ThreadState& thread_state);
 
-template<class S, class M, class R>
-void SearchBase<S, M, R>::Thread::thread_main()
-{
-    unique_lock<mutex> lock(m_start_search_mutex);
-    {
-        lock_guard lock(m_thread_ready_mutex);
-        m_thread_ready_flag = true;
-        m_thread_ready_cond.notify_one();
-    }
-    while (true)
-    {
-        while (! m_start_search_flag)
-            m_start_search_cond.wait(lock);
-        m_start_search_flag = false;
-        if (m_quit)
-            break;
-        m_search_func(thread_state);
-        {
-            lock_guard lock(m_search_finished_mutex);
-            m_search_finished_flag = true;
-        }
-        m_search_finished_cond.notify_one();
-    }
-}
+    void update_values(ThreadState& thread_state);
 
-template<class S, class M, class R>
-void SearchBase<S, M, R>::Thread::wait_search_finished()
-{
-    LIBBOARDGAME_ASSERT(m_thread.joinable());
-    while (! m_search_finished_flag)
-        m_search_finished_cond.wait(m_search_finished_lock);
-    m_search_finished_flag = false;
-    m_search_finished_lock.unlock();
-}
+    /** Create more children of a partially expanded node.
+        See SearchParamConstDefault::widening_nu_children. The state must be
+        at the position of the node in the in-tree phase. Does nothing if
+        another thread is already widening the node.
+        @return false if the tree has not enough capacity left. */
+    bool widen_node(ThreadState& thread_state, const Node& node,
+                    unsigned max_children);
+
+    /** Replace nodes of the current simulation by their copies if their
+        parent was widened by another thread during the simulation.
+        Otherwise the values of the simulation would be added to the old
+        children, which are no longer used, and the virtual losses copied to
+        the new children would never be removed. */
+    void find_copied_nodes(ThreadState& thread_state);
+};
 
 
 #ifdef LIBBOARDGAME_DEBUG
@@ -664,13 +681,16 @@ void SearchBase<S, M, R>::AssertionHandler::run()
 
 template<class S, class M, class R>
 SearchBase<S, M, R>::SearchBase(unsigned nu_threads, size_t memory)
-    : m_tree(memory / 2, nu_threads),
-      m_nu_threads(nu_threads),
-      m_tmp_tree(memory / 2, m_nu_threads)
+    : m_tree(memory, nu_threads),
+      m_nu_threads(nu_threads)
 #ifdef LIBBOARDGAME_DEBUG
       , m_assertion_handler(*this)
 #endif
-{ }
+{
+    LIBBOARDGAME_LOG("Tree nodes: ", m_tree.get_max_nodes(),
+                     ", huge pages advised: ",
+                     m_tree.is_huge_page_advised() ? "yes" : "no");
+}
 
 template<class S, class M, class R>
 SearchBase<S, M, R>::~SearchBase() = default; // Non-inline to avoid GCC -Winline warning
@@ -684,6 +704,12 @@ bool SearchBase<S, M, R>::check_abort(
         LIBBOARDGAME_LOG_THREAD(thread_state, "Maximum count reached");
         return true;
     }
+    if (SearchParamConst::use_solver
+            && m_tree.get_root().get_proven() != ProvenResult::none)
+    {
+        LIBBOARDGAME_LOG_THREAD(thread_state, "Root is proven");
+        return true;
+    }
     return false;
 }
 
@@ -789,23 +815,20 @@ void SearchBase<S, M, R>::create_threads()
         throw runtime_error("libboardgame_mcts::Search was compiled"
                             " without support for multithreading");
     LIBBOARDGAME_LOG("Creating ", m_nu_threads, " threads");
-    m_threads.clear();
-    m_threads.reserve(m_nu_threads);
-    auto search_func =
-        static_cast<typename Thread::SearchFunc>(
-                          bind(&SearchBase::search_loop, this, placeholders::_1));
+    m_thread_states.clear();
+    m_thread_states.reserve(m_nu_threads);
     for (unsigned i = 0; i < m_nu_threads; ++i)
     {
-        auto t = make_unique<Thread>(search_func);
-        auto& thread_state = t->thread_state;
-        thread_state.thread_id = i;
-        thread_state.state = create_state();
-        for (auto& was_played : thread_state.was_played)
+        auto thread_state = make_unique<ThreadState>();
+        thread_state->thread_id = i;
+        thread_state->state = create_state();
+        for (auto& was_played : thread_state->was_played)
             was_played = max_players;
-        if (i > 0)
-            t->run();
-        m_threads.push_back(move(t));
+        m_thread_states.push_back(move(thread_state));
     }
+    // The calling thread of search() is used as the first search thread
+    if (m_nu_threads > 1)
+        ThreadPool::get_global().reserve(m_nu_threads - 1);
 }
 
 #ifdef LIBBOARDGAME_DEBUG
@@ -828,20 +851,100 @@ bool SearchBase<S, M, R>::expand_node(ThreadState& thread_state,
                                       const Node*& best_child)
 {
     auto& state = *thread_state.state;
+    if constexpr (SearchParamConst::use_transpositions)
+        if (m_use_transpositions)
+        {
+            NodeIdx first_child;
+            unsigned nu_children;
+            if (m_transposition_table.lookup(state.get_hash(), first_child,
+                                             nu_children))
+            {
+                auto begin = &m_tree.get_node(first_child);
+                if constexpr (SearchParamConst::use_solver)
+                    // The table does not store if the children are complete
+                    m_tree.set_has_all_moves(node, false);
+                m_tree.link_children(node, begin, nu_children);
+                best_child = select_child(
+                            node,
+                            typename Tree::Children(begin,
+                                                    begin + nu_children));
+                m_nu_transpositions.fetch_add(1);
+                return true;
+            }
+        }
     auto thread_id = thread_state.thread_id;
     typename Tree::NodeExpander expander(thread_id, m_tree,
                                          SearchParamConst::child_min_count,
                                          SearchParamConst::max_move_prior);
+    if constexpr (SearchParamConst::widening_nu_children > 0)
+        if (&node != &m_tree.get_root())
+            expander.set_max_children(SearchParamConst::widening_nu_children);
     auto root_val = m_root_val[state.get_player()].get_mean();
     if (state.gen_children(expander, root_val))
     {
+        if constexpr (SearchParamConst::use_solver)
+            m_tree.set_has_all_moves(node, state.has_all_moves()
+                                     && ! expander.is_truncated());
         expander.link_children(m_tree, node);
         best_child = expander.get_best_child();
+        if constexpr (SearchParamConst::use_transpositions)
+            // Children of partially expanded nodes are not shared because
+            // each parent would replace them by its own copies when widening
+            if (m_use_transpositions && ! expander.is_truncated())
+            {
+                auto nu_children = node.get_nu_children();
+                if (nu_children > 0)
+                    m_transposition_table.store(
+                                state.get_hash(), node.get_first_child(),
+                                static_cast<unsigned>(nu_children));
+            }
         return true;
     }
     return false;
 }
 
+template<class S, class M, class R>
+void SearchBase<S, M, R>::find_copied_nodes(ThreadState& thread_state)
+{
+    auto& nodes = thread_state.simulation.nodes;
+    for (unsigned i = 1; i < nodes.size(); ++i)
+    {
+        auto children = m_tree.get_children(*nodes[i - 1]);
+        if (nodes[i] >= children.begin() && nodes[i] < children.end())
+            continue;
+        // The copies of the old children can have a different order
+        auto mv = nodes[i]->get_move();
+        for (auto& child : children)
+            if (child.get_move() == mv)
+            {
+                nodes[i] = &child;
+                break;
+            }
+    }
+}
+
+template<class S, class M, class R>
+ProvenResult SearchBase<S, M, R>::get_proven_from_children(
+        const Node& node) const
+{
+    auto children = m_tree.get_children(node);
+    if (children.empty())
+        return ProvenResult::none;
+    bool is_proven = node.has_all_moves();
+    auto result = ProvenResult::loss;
+    for (auto& i : children)
+    {
+        auto child_result = i.get_proven();
+        if (child_result == ProvenResult::win)
+            return ProvenResult::win;
+        if (child_result == ProvenResult::none)
+            is_proven = false;
+        else if (child_result == ProvenResult::draw)
+            result = ProvenResult::draw;
+    }
+    return is_proven ? result : ProvenResult::none;
+}
+
 template<class S, class M, class R>
 inline size_t SearchBase<S, M, R>::get_nu_simulations() const
 {
@@ -902,15 +1005,15 @@ inline bool SearchBase<S, M, R>::get_reuse_tree() const
 template<class S, class M, class R>
 inline S& SearchBase<S, M, R>::get_state(unsigned thread_id)
 {
-    LIBBOARDGAME_ASSERT(thread_id < m_threads.size());
-    return *m_threads[thread_id]->thread_state.state;
+    LIBBOARDGAME_ASSERT(thread_id < m_thread_states.size());
+    return *m_thread_states[thread_id]->state;
 }
 
 template<class S, class M, class R>
 inline const S& SearchBase<S, M, R>::get_state(unsigned thread_id) const
 {
-    LIBBOARDGAME_ASSERT(thread_id < m_threads.size());
-    return *m_threads[thread_id]->thread_state.state;
+    LIBBOARDGAME_ASSERT(thread_id < m_thread_states.size());
+    return *m_thread_states[thread_id]->state;
 }
 
 template<class S, class M, class R>
@@ -929,20 +1032,7 @@ template<class S, class M, class R>
 void SearchBase<S, M, R>::playout(ThreadState& thread_state)
 {
     auto& state = *thread_state.state;
-    state.start_playout();
-    auto& simulation = thread_state.simulation;
-    auto& moves = simulation.moves;
-    auto nu_moves = moves.size();
-    Move last = nu_moves > 0 ? moves[nu_moves - 1].move : Move::null();
-    Move second_last = nu_moves > 1 ? moves[nu_moves - 2].move : Move::null();
-    PlayerMove mv;
-    while (state.gen_playout_move(m_lgr, last, second_last, mv))
-    {
-        state.play_playout(mv.move);
-        moves.push_back(mv);
-        second_last = last;
-        last = mv.move;
-    }
+    state.playout(m_lgr, thread_state.simulation.moves);
 }
 
 template<class S, class M, class R>
@@ -952,15 +1042,38 @@ void SearchBase<S, M, R>::play_in_tree(ThreadState& thread_state)
     auto& simulation = thread_state.simulation;
     simulation.nodes.resize(1);
     simulation.moves.clear();
+    if constexpr (SearchParamConst::widening_nu_children > 0)
+        thread_state.nu_widenings =
+                m_nu_widenings.load(memory_order_relaxed);
     auto& root = m_tree.get_root();
     auto node = &root;
     Float expansion_threshold = SearchParamConst::expansion_threshold;
     typename Tree::Children children;
     while (! (children = m_tree.get_children(*node)).empty())
     {
+        if constexpr (SearchParamConst::widening_nu_children > 0)
+            if (node->is_partially_expanded()
+                    && node->get_visit_count()
+                       >= SearchParamConst::widening_visit_ratio
+                          * static_cast<Float>(children.size()))
+            {
+                if (! widen_node(thread_state, *node,
+                                 2 * static_cast<unsigned>(children.size())))
+                {
+                    thread_state.is_out_of_mem = true;
+                    return;
+                }
+                continue;
+            }
         node = select_child(*node, children);
         if (multithread && SearchParamConst::virtual_loss)
-            m_tree.add_value(*node, 0);
+        {
+            if (simulation.nodes.size()
+                    <= SearchParamConst::atomic_update_depth)
+                m_tree.add_value_atomic(*node, 0);
+            else
+                m_tree.add_value(*node, 0);
+        }
         simulation.nodes.push_back(node);
         Move mv = node->get_move();
         simulation.moves.push_back({state.get_player(), mv});
@@ -980,6 +1093,14 @@ void SearchBase<S, M, R>::play_in_tree(ThreadState& thread_state)
             simulation.moves.push_back({state.get_player(), mv});
             state.play_expanded_child(mv);
         }
+        else if (SearchParamConst::use_solver && m_use_solver
+                 && ! simulation.moves.empty())
+        {
+            // Terminal position
+            auto& terminal = *simulation.nodes.back();
+            auto player = simulation.moves.back().player;
+            m_tree.set_proven(terminal, state.get_proven_result(player));
+        }
     }
     thread_state.stat_in_tree_len.add(double(simulation.moves.size()));
 }
@@ -988,20 +1109,31 @@ template<class S, class M, class R>
 string SearchBase<S, M, R>::get_info() const
 {
     auto& root = m_tree.get_root();
-    if (m_threads.empty())
+    if (m_thread_states.empty())
         return {};
-    auto& thread_state = m_threads[0]->thread_state;
+    auto& thread_state = *m_thread_states[0];
     ostringstream s;
     s << fixed << setprecision(2) << "Val " << get_root_val().get_mean()
       << setprecision(0) << ", ValCnt " << get_root_val().get_count()
       << ", Vst " << get_root_visit_count()
       << ", Sim " << m_nu_simulations;
+    if (m_use_solver)
+        switch (root.get_proven())
+        {
+        case ProvenResult::win: s << ", Proven win"; break;
+        case ProvenResult::loss: s << ", Proven loss"; break;
+        case ProvenResult::draw: s << ", Proven draw"; break;
+        case ProvenResult::none: break;
+        }
     auto child = select_final();
     if (child && root.get_visit_count() > 0)
         s << setprecision(1) << ", Chld "
           << (100 * child->get_visit_count() / root.get_visit_count())
           << '%';
-    s << "\nNds " << m_tree.get_nu_nodes()
+    s << "\nNds " << m_tree.get_nu_nodes();
+    if (m_use_transpositions)
+        s << ", Trn " << m_nu_transpositions;
+    s
       << ", Tm " << time_to_string(m_last_time)
       << setprecision(0) << ", Sim/s "
       << (double(m_nu_simulations) / m_last_time)
@@ -1023,14 +1155,15 @@ bool SearchBase<S, M, R>::prune(
         Float prune_min_count, Float& new_prune_min_count)
 {
     Timer timer(time_source);
-    m_tmp_tree.clear();
-    m_tree.copy_subtree(m_tmp_tree, m_tmp_tree.get_root(), m_tree.get_root(),
-                        prune_min_count);
-    auto percent = int(m_tmp_tree.get_nu_nodes() * 100 / m_tree.get_nu_nodes());
+    auto nu_nodes = m_tree.get_nu_nodes();
+    m_tree.prune(prune_min_count);
+    auto percent = int(m_tree.get_nu_nodes() * 100 / nu_nodes);
     LIBBOARDGAME_LOG("Pruning MinCnt: ", prune_min_count, ", AtTm: ", time,
-                     ", Nds: ", m_tmp_tree.get_nu_nodes(), " (", percent,
+                     ", Nds: ", m_tree.get_nu_nodes(), " (", percent,
                      "%), Tm: ", timer());
-    m_tree.swap(m_tmp_tree);
+    if (m_use_transpositions)
+        // Node indices stored in the table are no longer valid
+        m_transposition_table.clear();
     if (percent > 50)
     {
         if (prune_min_count >= 0.5f * numeric_limits<Float>::max())
@@ -1071,7 +1204,7 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
                                  size_t min_simulations, double max_time,
                                  TimeSource& time_source)
 {
-    if (m_nu_threads != m_threads.size())
+    if (m_nu_threads != m_thread_states.size())
         create_threads();
     m_deterministic = RandomGenerator::has_global_seed();
     bool is_followup = check_followup(m_followup_sequence);
@@ -1100,8 +1233,8 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
     else
         for (PlayerInt i = 0; i < m_nu_players; ++i)
             m_root_val[i].init(SearchParamConst::tie_value, 1);
-    if ((m_reuse_subtree && (is_followup || m_abort))
-            || (m_reuse_tree && is_same))
+    if ((m_reuse_subtree && (is_followup || m_was_aborted))
+            || ((m_reuse_tree || m_is_tree_read) && is_same))
     {
         size_t tree_nodes = m_tree.get_nu_nodes();
         if (m_followup_sequence.empty())
@@ -1109,33 +1242,31 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
             if (tree_nodes > 1)
                 LIBBOARDGAME_LOG("Reusing all ", tree_nodes, " nodes (count=",
                                  m_tree.get_root().get_visit_count(), ")");
+            clear_tree = false;
         }
         else
         {
             Timer timer(time_source);
-            m_tmp_tree.clear();
             auto node = find_node(m_tree, m_followup_sequence);
             if (node)
             {
-                m_tree.extract_subtree(m_tmp_tree, *node);
-                auto& tmp_tree_root = m_tmp_tree.get_root();
+                m_tree.make_root(*node);
+                auto& root = m_tree.get_root();
                 if (! is_same)
                 {
                     Float value, count;
-                    if (estimate_reused_root_val(m_tmp_tree, tmp_tree_root,
-                                                 value, count))
+                    if (estimate_reused_root_val(m_tree, root, value, count))
                         m_root_val[m_player].add(value, count);
                 }
-                size_t tmp_tree_nodes = m_tmp_tree.get_nu_nodes();
-                if (tree_nodes > 1 && tmp_tree_nodes > 1)
+                size_t reused_nodes = m_tree.get_nu_nodes();
+                if (tree_nodes > 1 && reused_nodes > 1)
                 {
                     double time = timer();
-                    LIBBOARDGAME_LOG("Reusing ", tmp_tree_nodes, " nodes (",
+                    LIBBOARDGAME_LOG("Reusing ", reused_nodes, " nodes (",
                                      std::fixed, setprecision(1),
-                                     100 * double(tmp_tree_nodes)
+                                     100 * double(reused_nodes)
                                      / double(tree_nodes),
                                      "% tm=", setprecision(4), time, ")");
-                    m_tree.swap(m_tmp_tree);
                     clear_tree = false;
                     max_time -= time;
                     if (max_time < 0)
@@ -1146,15 +1277,17 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
     }
     if (clear_tree)
         m_tree.clear();
+    m_is_tree_read = false;
+    if (m_use_transpositions)
+        m_transposition_table.clear();
 
     m_timer.reset(time_source);
     m_time_source = &time_source;
-    m_abort = false;
     if (SearchParamConst::use_lgr && ! is_followup)
         m_lgr.init(m_nu_players);
-    for (auto& i : m_threads)
+    for (auto& i : m_thread_states)
     {
-        auto& thread_state = i->thread_state;
+        auto& thread_state = *i;
         thread_state.stat_len.clear();
         thread_state.stat_in_tree_len.clear();
         thread_state.state->start_search();
@@ -1163,6 +1296,8 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
     m_min_simulations = min_simulations;
     m_max_time = max_time;
     m_nu_simulations.store(0);
+    m_nu_transpositions.store(0);
+    m_nu_widenings.store(0);
     Float prune_min_count = SearchParamConst::prune_count_start;
 
     // Don't use multi-threading for very short searches (less than 0.5s).
@@ -1181,8 +1316,18 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
         nu_threads = 1;
     }
 
-    auto& thread_state_0 = m_threads[0]->thread_state;
+    auto& thread_state_0 = *m_thread_states[0];
     auto& root = m_tree.get_root();
+    if (root.get_nu_children() > 0 && root.is_partially_expanded())
+    {
+        // Reused subtree, the root should have all children
+        thread_state_0.state->start_simulation(0);
+        if (! widen_node(thread_state_0, root, Node::max_children))
+        {
+            LIBBOARDGAME_LOG("Could not widen reused root");
+            m_tree.clear();
+        }
+    }
     if (root.get_nu_children() <= 0)
     {
         const Node* best_child;
@@ -1191,6 +1336,12 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
         expand_node(thread_state_0, root, best_child);
     }
 
+    // The result of a reused root was stored from the point of view of the
+    // player at its parent
+    m_use_solver = (SearchParamConst::use_solver && m_nu_players == 2);
+    m_tree.set_proven(root, m_use_solver ? get_proven_from_children(root)
+                                         : ProvenResult::none);
+
     auto nu_children = root.get_nu_children();
     if (nu_children <= 0)
         LIBBOARDGAME_LOG("No legal moves at root");
@@ -1199,14 +1350,13 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
     else
         while (true)
         {
-            for (unsigned i = 1; i < nu_threads; ++i)
-                m_threads[i]->start_search();
-            search_loop(thread_state_0);
-            for (unsigned i = 1; i < nu_threads; ++i)
-                m_threads[i]->wait_search_finished();
+            if (nu_threads == 1)
+                search_loop(thread_state_0);
+            else
+                run_search_loops(nu_threads);
             bool is_out_of_mem = false;
             for (unsigned i = 0; i < nu_threads; ++i)
-                if (m_threads[i]->thread_state.is_out_of_mem)
+                if (m_thread_states[i]->is_out_of_mem)
                 {
                     is_out_of_mem = true;
                     break;
@@ -1218,12 +1368,55 @@ bool SearchBase<S, M, R>::search(Move& mv, Float max_count,
         }
 
     m_last_time = m_timer();
+    m_was_aborted = m_abort;
     LIBBOARDGAME_LOG(get_info());
     bool result = select_move(mv);
     m_time_source = nullptr;
     return result;
 }
 
+template<class S, class M, class R>
+void SearchBase<S, M, R>::read_tree(
+        istream& in, const function<bool(const Move&)>& is_valid_move)
+{
+    uint_least32_t nu_players;
+    in.read(reinterpret_cast<char*>(&nu_players), sizeof(nu_players));
+    if (! in || nu_players == 0 || nu_players > max_players)
+        throw runtime_error("invalid tree format");
+    for (unsigned i = 0; i < nu_players; ++i)
+    {
+        Float mean;
+        Float count;
+        in.read(reinterpret_cast<char*>(&mean), sizeof(mean));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (! in)
+            throw runtime_error("invalid tree format");
+        m_root_val[i].init(mean, count);
+    }
+    m_tree.read(in, is_valid_move);
+    m_is_tree_read = true;
+}
+
+template<class S, class M, class R>
+void SearchBase<S, M, R>::run_search_loops(unsigned nu_threads)
+{
+    m_search_loop_finished.store(false, memory_order_relaxed);
+    vector<ThreadPool::Task> tasks;
+    tasks.reserve(nu_threads);
+    for (unsigned i = 0; i < nu_threads; ++i)
+    {
+        auto& thread_state = *m_thread_states[i];
+        thread_state.is_out_of_mem = false;
+        tasks.emplace_back([this, &thread_state] {
+            if (m_search_loop_finished.load(memory_order_relaxed))
+                return;
+            search_loop(thread_state);
+            m_search_loop_finished.store(true, memory_order_relaxed);
+        });
+    }
+    ThreadPool::get_global().run(tasks);
+}
+
 template<class S, class M, class R>
 void SearchBase<S, M, R>::search_loop(ThreadState& thread_state)
 {
@@ -1258,7 +1451,13 @@ void SearchBase<S, M, R>::search_loop(ThreadState& thread_state)
         playout(thread_state);
         state.evaluate_playout(simulation.eval);
         thread_state.stat_len.add(double(simulation.moves.size()));
+        if constexpr (SearchParamConst::widening_nu_children > 0)
+            if (m_nu_widenings.load(memory_order_relaxed)
+                    != thread_state.nu_widenings)
+                find_copied_nodes(thread_state);
         update_values(thread_state);
+        if (SearchParamConst::use_solver && m_use_solver)
+            update_proven(thread_state);
         if (SearchParamConst::rave)
             update_rave(thread_state);
         if (SearchParamConst::use_lgr)
@@ -1287,44 +1486,43 @@ inline auto SearchBase<S, M, R>::select_child(
     auto expl_limit =
             expl_factor * SearchParamConst::max_move_prior
             / SearchParamConst::child_min_count;
-    auto i = children.begin();
-    auto value =
-            i->get_value()
-            + i->get_move_prior() * expl_factor / i->get_value_count();
-    auto best_value = value;
-    auto limit = best_value - expl_limit;
-    auto best_child = i;
-    while (++i != children.end())
-    {
-        value = i->get_value();
-        if (value <= limit)
-            continue;
-        value += i->get_move_prior() * expl_factor / i->get_value_count();
-        if (value > best_value)
-        {
-            best_value = value;
-            limit = best_value - expl_limit;
-            best_child = i;
-        }
-    }
-    return best_child;
+#ifdef __SSE2__
+    if constexpr (is_same_v<Float, float>)
+        return select_child_sse2(children, expl_factor);
+    else
+#endif
+        return select_child_scalar(children, expl_factor, expl_limit);
 }
 
 template<class S, class M, class R>
 auto SearchBase<S, M, R>::select_final() const-> const Node*
 {
-    // Select the child with the highest number of wins
+    // Select the child with the highest number of wins, proven wins first
+    // and proven losses last if the solver is used
     auto children = m_tree.get_children(m_tree.get_root());
     if (children.empty())
         return nullptr;
+    auto get_rank = [&](const Node& node) {
+        if (! m_use_solver)
+            return 0;
+        auto result = node.get_proven();
+        if (result == ProvenResult::win)
+            return 1;
+        if (result == ProvenResult::loss)
+            return -1;
+        return 0;
+    };
     auto i = children.begin();
     auto best_child = i;
+    auto max_rank = get_rank(*i);
     auto max_wins = i->get_value_count() * i->get_value();
     while (++i != children.end())
     {
+        auto rank = get_rank(*i);
         auto wins = i->get_value_count() * i->get_value();
-        if (wins > max_wins)
+        if (rank > max_rank || (rank == max_rank && wins > max_wins))
         {
+            max_rank = rank;
             max_wins = wins;
             best_child = i;
         }
@@ -1381,6 +1579,24 @@ void SearchBase<S, M, R>::set_reuse_tree(bool enable)
     m_reuse_tree = enable;
 }
 
+template<class S, class M, class R>
+void SearchBase<S, M, R>::set_use_transpositions(bool enable)
+{
+    if (enable == m_use_transpositions)
+        return;
+    if (enable && ! SearchParamConst::use_transpositions)
+        throw runtime_error("libboardgame_mcts::Search was compiled"
+                            " without support for transpositions");
+    m_use_transpositions = enable;
+    m_tree.clear();
+    m_tree.set_shared_children(enable);
+    if (enable && m_transposition_table.get_size() == 0)
+        // The table needs one entry per expanded node and expanded nodes
+        // usually have many more than 16 children
+        m_transposition_table =
+                TranspositionTable<multithread>(m_tree.get_max_nodes() / 16);
+}
+
 template<class S, class M, class R>
 void SearchBase<S, M, R>::update_lgr(ThreadState& thread_state)
 {
@@ -1423,6 +1639,7 @@ void SearchBase<S, M, R>::update_rave(ThreadState& thread_state)
     auto nu_moves = static_cast<unsigned>(moves.size());
     if (nu_moves == 0)
         return;
+    static_assert(max_moves - 1 <= numeric_limits<uint_least16_t>::max());
     auto& was_played = thread_state.was_played;
     auto& first_play = thread_state.first_play;
     auto& nodes = thread_state.simulation.nodes;
@@ -1439,7 +1656,7 @@ void SearchBase<S, M, R>::update_rave(ThreadState& thread_state)
         if (state.skip_rave(mv.move))
             continue;
         was_played[mv.move.to_int()] = mv.player;
-        first_play[mv.move.to_int()] = i;
+        first_play[mv.move.to_int()] = static_cast<uint_least16_t>(i);
     }
 
     // Add RAVE values to children of nodes of current simulation
@@ -1471,7 +1688,7 @@ void SearchBase<S, M, R>::update_rave(ThreadState& thread_state)
         if (! state.skip_rave(mv.move))
         {
             was_played[mv.move.to_int()] = player;
-            first_play[mv.move.to_int()] = i;
+            first_play[mv.move.to_int()] = static_cast<uint_least16_t>(i);
         }
         --i;
     }
@@ -1481,6 +1698,39 @@ void SearchBase<S, M, R>::update_rave(ThreadState& thread_state)
         was_played[moves[i].move.to_int()] = max_players;
 }
 
+/** Propagate the result of a proven node at the end of the in-tree phase of
+    the simulation to its ancestors. */
+template<class S, class M, class R>
+void SearchBase<S, M, R>::update_proven(ThreadState& thread_state)
+{
+    const auto& simulation = thread_state.simulation;
+    auto& nodes = simulation.nodes;
+    auto& moves = simulation.moves;
+    auto i = static_cast<unsigned>(nodes.size()) - 1;
+    if (nodes[i]->get_proven() == ProvenResult::none)
+        return;
+    while (i > 0)
+    {
+        --i;
+        auto& node = *nodes[i];
+        if (node.get_proven() != ProvenResult::none)
+            return;
+        // The results of the children are from the point of view of the
+        // player to play at the node
+        auto player = moves[i].player;
+        ProvenResult result;
+        if (nodes[i + 1]->get_proven() == ProvenResult::win)
+            result = ProvenResult::win;
+        else
+            result = get_proven_from_children(node);
+        if (result == ProvenResult::none)
+            return;
+        if (i > 0 && moves[i - 1].player != player)
+            result = get_inverse(result);
+        m_tree.set_proven(node, result);
+    }
+}
+
 template<class S, class M, class R>
 void SearchBase<S, M, R>::update_values(ThreadState& thread_state)
 {
@@ -1488,8 +1738,26 @@ void SearchBase<S, M, R>::update_values(ThreadState& thread_state)
     auto& nodes = simulation.nodes;
     auto& eval = simulation.eval;
     auto nu_nodes = static_cast<unsigned>(nodes.size());
-    m_tree.inc_visit_count(*nodes[0]);
-    for (unsigned i = 1; i < nu_nodes; ++i)
+    unsigned i = 1;
+    if (multithread)
+    {
+        m_tree.inc_visit_count_atomic(*nodes[0]);
+        auto nu_nodes_atomic =
+                min(nu_nodes, SearchParamConst::atomic_update_depth + 1);
+        for ( ; i < nu_nodes_atomic; ++i)
+        {
+            auto& node = *nodes[i];
+            auto mv = simulation.moves[i - 1];
+            if (SearchParamConst::virtual_loss)
+                m_tree.add_value_remove_loss_atomic(node, eval[mv.player]);
+            else
+                m_tree.add_value_atomic(node, eval[mv.player]);
+            m_tree.inc_visit_count_atomic(node);
+        }
+    }
+    else
+        m_tree.inc_visit_count(*nodes[0]);
+    for ( ; i < nu_nodes; ++i)
     {
         auto& node = *nodes[i];
         auto mv = simulation.moves[i - 1];
@@ -1510,6 +1778,58 @@ void SearchBase<S, M, R>::update_values(ThreadState& thread_state)
         m_root_val[i].add(eval[i]);
 }
 
+template<class S, class M, class R>
+bool SearchBase<S, M, R>::widen_node(ThreadState& thread_state,
+                                     const Node& node, unsigned max_children)
+{
+    // Only one thread may widen the node, otherwise the copies of the old
+    // children made by one thread would be replaced by another thread
+    if (! m_tree.start_widening(node))
+        return true;
+    auto& state = *thread_state.state;
+    typename Tree::NodeExpander expander(thread_state.thread_id, m_tree,
+                                         SearchParamConst::child_min_count,
+                                         SearchParamConst::max_move_prior);
+    expander.set_max_children(max_children);
+    auto root_val = m_root_val[state.get_player()].get_mean();
+    state.finish_in_tree();
+    if (! state.gen_children(expander, root_val))
+    {
+        m_tree.set_partially_expanded(node, true);
+        return false;
+    }
+    bool is_truncated = expander.is_truncated();
+    expander.link_children(m_tree, node);
+    m_nu_widenings.fetch_add(1);
+    // Set only after the children are linked because the old children are
+    // not complete
+    if constexpr (SearchParamConst::use_solver)
+        m_tree.set_has_all_moves(node,
+                                 state.has_all_moves() && ! is_truncated);
+    if constexpr (SearchParamConst::use_transpositions)
+        if (m_use_transpositions && ! is_truncated
+                && node.get_nu_children() > 0)
+            m_transposition_table.store(
+                        state.get_hash(), node.get_first_child(),
+                        static_cast<unsigned>(node.get_nu_children()));
+    return true;
+}
+
+template<class S, class M, class R>
+void SearchBase<S, M, R>::write_tree(ostream& out) const
+{
+    uint_least32_t nu_players = m_nu_players;
+    out.write(reinterpret_cast<const char*>(&nu_players), sizeof(nu_players));
+    for (unsigned i = 0; i < nu_players; ++i)
+    {
+        Float mean = m_root_val[i].get_mean();
+        Float count = m_root_val[i].get_count();
+        out.write(reinterpret_cast<const char*>(&mean), sizeof(mean));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    m_tree.write(out);
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libboardgame_mcts
@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/SelectChild.h
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#ifndef LIBBOARDGAME_MCTS_SELECT_CHILD_H
+#define LIBBOARDGAME_MCTS_SELECT_CHILD_H
+
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "libboardgame_base/Range.h"
+
+namespace libboardgame_mcts {
+
+using namespace std;
+using libboardgame_base::Range;
+
+//-----------------------------------------------------------------------------
+
+/** Get the child with the highest value plus exploration term.
+    See the class description of SearchBase for the exploration term.
+    @param children The children.
+    @param expl_factor The exploration factor of the parent.
+    @param expl_limit An upper bound for the exploration term of a child.
+    Children with a value that is this much lower than the best value so far
+    are skipped without computing their exploration term.
+    @pre ! children.empty() */
+template<typename N>
+const N* select_child_scalar(const Range<const N>& children,
+                             typename N::Float expl_factor,
+                             typename N::Float expl_limit)
+{
+    auto i = children.begin();
+    auto value =
+            i->get_value()
+            + i->get_move_prior() * expl_factor / i->get_value_count();
+    auto best_value = value;
+    auto limit = best_value - expl_limit;
+    auto best_child = i;
+    while (++i != children.end())
+    {
+        value = i->get_value();
+        if (value <= limit)
+            continue;
+        value += i->get_move_prior() * expl_factor / i->get_value_count();
+        if (value > best_value)
+        {
+            best_value = value;
+            limit = best_value - expl_limit;
+            best_child = i;
+        }
+    }
+    return best_child;
+}
+
+#ifdef __SSE2__
+
+/** Vectorized version of select_child_scalar() for nodes with Float=float.
+    Computes the values of four children at a time and compares them one by
+    one only if one of them is better than the best child so far. Returns the
+    same child as select_child_scalar() if the exploration terms of the
+    children are not larger than its expl_limit, apart from rounding
+    differences if the values of the best children are nearly equal.
+    @pre ! children.empty() */
+template<typename N>
+const N* select_child_sse2(const Range<const N>& children, float expl_factor)
+{
+    // The nodes are too large to be loaded with a single instruction, so the
+    // gain comes from doing the divisions and comparisons four at a time.
+    auto best_value = -numeric_limits<float>::max();
+    auto best_child = children.begin();
+    auto factor = _mm_set1_ps(expl_factor);
+    auto best = _mm_set1_ps(best_value);
+    auto select = [&](const N* i) {
+        auto value = _mm_set_ps(i[3].get_value(), i[2].get_value(),
+                                i[1].get_value(), i[0].get_value());
+        auto move_prior =
+                _mm_set_ps(i[3].get_move_prior(), i[2].get_move_prior(),
+                           i[1].get_move_prior(), i[0].get_move_prior());
+        auto value_count =
+                _mm_set_ps(i[3].get_value_count(), i[2].get_value_count(),
+                           i[1].get_value_count(), i[0].get_value_count());
+        value = _mm_add_ps(value, _mm_div_ps(_mm_mul_ps(move_prior, factor),
+                                             value_count));
+        if (_mm_movemask_ps(_mm_cmpgt_ps(value, best)) == 0)
+            return;
+        alignas(16) float values[4];
+        _mm_store_ps(values, value);
+        for (unsigned j = 0; j < 4; ++j)
+            if (values[j] > best_value)
+            {
+                best_value = values[j];
+                best_child = i + j;
+            }
+        best = _mm_set1_ps(best_value);
+    };
+    auto i = children.begin();
+    for ( ; children.end() - i >= 4; i += 4)
+        select(i);
+    if (i == children.end())
+        return best_child;
+    if (children.size() >= 4)
+    {
+        // Compute the remaining children with the last four children, which
+        // overlap with the children already computed. This gives equal
+        // children exactly the same value, whereas a scalar division can
+        // differ from the vector division in the last bit with -ffast-math.
+        // The children in the overlap cannot become better than best_value.
+        select(children.end() - 4);
+        return best_child;
+    }
+    for ( ; i != children.end(); ++i)
+    {
+        auto value =
+                i->get_value()
+                + i->get_move_prior() * expl_factor / i->get_value_count();
+        if (value > best_value)
+        {
+            best_value = value;
+            best_child = i;
+        }
+    }
+    return best_child;
+}
+
+#endif // __SSE2__
+
+//-----------------------------------------------------------------------------
+
+} // namespace libboardgame_mcts
+
+#endif // LIBBOARDGAME_MCTS_SELECT_CHILD_H
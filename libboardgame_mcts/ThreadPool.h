@@ -0,0 +1,330 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/ThreadPool.h
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#ifndef LIBBOARDGAME_MCTS_THREAD_POOL_H
+#define LIBBOARDGAME_MCTS_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace libboardgame_mcts {
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+/** Persistent pool of worker threads with work stealing.
+    The threads are created once and reused for all tasks. The pool returned
+    by get_global() is shared by all searches in a process, so concurrent
+    searches do not use more threads than the largest of them needs.<p>
+    Each worker has its own queue. The tasks of a call to run() are
+    distributed to the queues of the workers and a worker with an empty queue
+    steals from the queues of the other workers. A worker spins for a short
+    time after running a task before it goes to sleep, which reduces the
+    latency of consecutive short runs. */
+class ThreadPool
+{
+public:
+    using Task = function<void()>;
+
+    /** Maximum number of worker threads. */
+    static constexpr unsigned max_threads = 256;
+
+
+    /** Get the pool shared by all users in the process. */
+    static ThreadPool& get_global();
+
+    ThreadPool() = default;
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned get_nu_threads() const
+    {
+        return m_nu_workers.load(memory_order_acquire);
+    }
+
+    /** Pin worker threads to CPUs.
+        If enabled, each worker thread that is created afterwards binds itself
+        to one of the CPUs that the process is allowed to run on, skipping the
+        first CPU, which is left to the calling thread of run(). This avoids
+        that the operating system moves the threads between CPUs. It does
+        not keep the tree memory of a thread on its own NUMA node because
+        the nodes are moved by Tree::prune() and a huge page holds the nodes
+        of several threads. Only supported on Linux, ignored elsewhere. Has
+        to be called before reserve(). */
+    void set_pin_threads(bool enable) { m_pin_threads = enable; }
+
+    /** Make sure that the pool has at least a given number of worker
+        threads.
+        The number is silently limited to max_threads. */
+    void reserve(unsigned nu_threads);
+
+    /** Run tasks in parallel and wait until all of them are finished.
+        The calling thread also runs tasks, so all tasks are run even if the
+        pool has no workers or all workers are busy with other tasks. A task
+        is run only once but it is unspecified by which thread. Tasks must not
+        call run() themselves. */
+    void run(const vector<Task>& tasks);
+
+private:
+    /** The tasks of one call to run().
+        The queues contain pointers to groups instead of tasks. Any thread
+        that takes a group from a queue runs the next task of the group that
+        is not yet claimed by another thread. */
+    class Group
+    {
+    public:
+        explicit Group(const vector<Task>& tasks)
+            : m_tasks(tasks),
+              m_nu_tasks(tasks.size())
+        { }
+
+        /** Run the next unclaimed task.
+            @return @c false if all tasks were already claimed. */
+        bool run_next();
+
+        void wait_finished();
+
+    private:
+        /** Valid only until all tasks are finished. */
+        const vector<Task>& m_tasks;
+
+        const size_t m_nu_tasks;
+
+        atomic<size_t> m_next{0};
+
+        size_t m_nu_finished = 0;
+
+        mutex m_mutex;
+
+        condition_variable m_finished_cond;
+    };
+
+    struct Worker
+    {
+        mutex queue_mutex;
+
+        deque<shared_ptr<Group>> queue;
+
+        thread worker_thread;
+    };
+
+
+    /** Number of iterations a worker spins before sleeping. */
+    static constexpr unsigned spin_count = 1000;
+
+    unique_ptr<Worker> m_workers[max_threads];
+
+    atomic<unsigned> m_nu_workers{0};
+
+    /** Number of groups in all queues. */
+    atomic<unsigned> m_nu_queued{0};
+
+    /** Index of the next queue used in run(). Protected by m_mutex. */
+    unsigned m_next_queue = 0;
+
+    bool m_quit = false;
+
+    bool m_pin_threads = false;
+
+    mutex m_mutex;
+
+    condition_variable m_wakeup_cond;
+
+
+    void pin_thread(unsigned worker_id);
+
+    shared_ptr<Group> pop(unsigned worker_id);
+
+    void thread_main(unsigned worker_id);
+};
+
+inline bool ThreadPool::Group::run_next()
+{
+    auto i = m_next.fetch_add(1, memory_order_relaxed);
+    if (i >= m_nu_tasks)
+        return false;
+    m_tasks[i]();
+    bool is_finished;
+    {
+        lock_guard lock(m_mutex);
+        is_finished = (++m_nu_finished == m_nu_tasks);
+    }
+    if (is_finished)
+        m_finished_cond.notify_all();
+    return true;
+}
+
+inline void ThreadPool::Group::wait_finished()
+{
+    unique_lock lock(m_mutex);
+    while (m_nu_finished != m_nu_tasks)
+        m_finished_cond.wait(lock);
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeup_cond.notify_all();
+    auto nu_workers = m_nu_workers.load(memory_order_acquire);
+    for (unsigned i = 0; i < nu_workers; ++i)
+        m_workers[i]->worker_thread.join();
+}
+
+inline ThreadPool& ThreadPool::get_global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+inline void ThreadPool::pin_thread([[maybe_unused]] unsigned worker_id)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    auto nu_cpus = static_cast<unsigned>(CPU_COUNT(&allowed));
+    if (nu_cpus < 2)
+        return;
+    // Index of the CPU among the allowed CPUs
+    auto n = (worker_id + 1) % nu_cpus;
+    for (unsigned i = 0; i < CPU_SETSIZE; ++i)
+    {
+        if (! CPU_ISSET(i, &allowed))
+            continue;
+        if (n-- > 0)
+            continue;
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(i, &cpu);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+        return;
+    }
+#endif
+}
+
+inline shared_ptr<ThreadPool::Group> ThreadPool::pop(unsigned worker_id)
+{
+    auto nu_workers = m_nu_workers.load(memory_order_acquire);
+    // Take from the front of the own queue, steal from the back of the
+    // other queues
+    for (unsigned i = 0; i < nu_workers; ++i)
+    {
+        auto& worker = *m_workers[(worker_id + i) % nu_workers];
+        lock_guard lock(worker.queue_mutex);
+        if (worker.queue.empty())
+            continue;
+        shared_ptr<Group> group;
+        if (i == 0)
+        {
+            group = move(worker.queue.front());
+            worker.queue.pop_front();
+        }
+        else
+        {
+            group = move(worker.queue.back());
+            worker.queue.pop_back();
+        }
+        m_nu_queued.fetch_sub(1, memory_order_relaxed);
+        return group;
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::reserve(unsigned nu_threads)
+{
+    nu_threads = min(nu_threads, max_threads);
+    lock_guard lock(m_mutex);
+    for (auto i = m_nu_workers.load(memory_order_relaxed); i < nu_threads; ++i)
+    {
+        m_workers[i] = make_unique<Worker>();
+        m_workers[i]->worker_thread =
+                thread(&ThreadPool::thread_main, this, i);
+        m_nu_workers.store(i + 1, memory_order_release);
+    }
+}
+
+inline void ThreadPool::run(const vector<Task>& tasks)
+{
+    if (tasks.empty())
+        return;
+    auto group = make_shared<Group>(tasks);
+    // The calling thread runs one of the tasks itself
+    auto nu_queued = min(tasks.size() - 1, size_t(get_nu_threads()));
+    if (nu_queued > 0)
+    {
+        {
+            lock_guard lock(m_mutex);
+            auto nu_workers = m_nu_workers.load(memory_order_relaxed);
+            for (size_t i = 0; i < nu_queued; ++i)
+            {
+                auto& worker = *m_workers[m_next_queue++ % nu_workers];
+                lock_guard queue_lock(worker.queue_mutex);
+                worker.queue.push_back(group);
+            }
+            m_nu_queued.fetch_add(static_cast<unsigned>(nu_queued),
+                                  memory_order_relaxed);
+        }
+        m_wakeup_cond.notify_all();
+    }
+    while (group->run_next()) { }
+    group->wait_finished();
+}
+
+inline void ThreadPool::thread_main(unsigned worker_id)
+{
+    if (m_pin_threads)
+        pin_thread(worker_id);
+    while (true)
+    {
+        if (auto group = pop(worker_id))
+        {
+            group->run_next();
+            continue;
+        }
+        bool is_queued = false;
+        for (unsigned i = 0; i < spin_count; ++i)
+        {
+            if (m_nu_queued.load(memory_order_relaxed) > 0)
+            {
+                is_queued = true;
+                break;
+            }
+            this_thread::yield();
+        }
+        if (is_queued)
+            continue;
+        unique_lock lock(m_mutex);
+        while (! m_quit && m_nu_queued.load(memory_order_relaxed) == 0)
+            m_wakeup_cond.wait(lock);
+        if (m_quit)
+            break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace libboardgame_mcts
+
+#endif // LIBBOARDGAME_MCTS_THREAD_POOL_H
@@ -0,0 +1,140 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/TranspositionTable.h
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#ifndef LIBBOARDGAME_MCTS_TRANSPOSITION_TABLE_H
+#define LIBBOARDGAME_MCTS_TRANSPOSITION_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include "Atomic.h"
+#include "Node.h"
+
+namespace libboardgame_mcts {
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+/** Hash table that maps position hashes to the children of expanded nodes.
+    Used for sharing the children between nodes that correspond to the same
+    position reached by different move sequences, which turns the search tree
+    into a directed acyclic graph.
+    The table is lock-free and has no collision resolution: a newer entry
+    simply replaces an older one with the same index. To detect entries that
+    were only partially written by another thread, the key is stored XOR'ed
+    with the data (see R. Hyatt, T. Mann: A lock-less transposition table
+    implementation for parallel search chess engines. ICGA Journal 25(1),
+    2002). Undetected collisions of the full 64-bit hash are assumed to be
+    rare enough to be ignored.
+    @tparam MT Whether the table is used in a multi-threaded search. */
+template<bool MT>
+class TranspositionTable
+{
+public:
+    using Hash = uint_least64_t;
+
+
+    /** Constructor.
+        @param size The number of entries. Will be rounded down to a power of
+        two. If zero, no memory is allocated and lookups always fail. */
+    explicit TranspositionTable(size_t size = 0);
+
+    /** Remove all entries.
+        Must be called whenever the node indices of the tree become invalid,
+        e.g. after clearing or pruning the tree. Not thread-safe. */
+    void clear();
+
+    /** Get the number of entries (0 if no memory was allocated). */
+    size_t get_size() const { return m_entries ? m_mask + 1 : 0; }
+
+    /** Find the children stored for a position.
+        @param hash
+        @param[out] first_child
+        @param[out] nu_children
+        @return @c true if an entry with this hash exists. */
+    bool lookup(Hash hash, NodeIdx& first_child, unsigned& nu_children) const;
+
+    /** Store the children of an expanded node.
+        @pre nu_children > 0 */
+    void store(Hash hash, NodeIdx first_child, unsigned nu_children);
+
+private:
+    struct Entry
+    {
+        Atomic<Hash, MT> key;
+
+        Atomic<Hash, MT> data;
+    };
+
+
+    unique_ptr<Entry[]> m_entries;
+
+    size_t m_mask;
+};
+
+template<bool MT>
+TranspositionTable<MT>::TranspositionTable(size_t size)
+{
+    if (size == 0)
+    {
+        m_mask = 0;
+        return;
+    }
+    size_t n = 1;
+    while (2 * n <= size)
+        n *= 2;
+    m_entries.reset(new Entry[n]);
+    m_mask = n - 1;
+    clear();
+}
+
+template<bool MT>
+void TranspositionTable<MT>::clear()
+{
+    if (! m_entries)
+        return;
+    for (size_t i = 0; i <= m_mask; ++i)
+    {
+        m_entries[i].key.store(0, memory_order_relaxed);
+        m_entries[i].data.store(0, memory_order_relaxed);
+    }
+}
+
+template<bool MT>
+inline bool TranspositionTable<MT>::lookup(Hash hash, NodeIdx& first_child,
+                                           unsigned& nu_children) const
+{
+    if (! m_entries)
+        return false;
+    auto& entry = m_entries[hash & m_mask];
+    Hash data = entry.data.load(memory_order_acquire);
+    Hash key = entry.key.load(memory_order_relaxed);
+    // data == 0 is an empty entry (a valid entry has nu_children > 0)
+    if (data == 0 || (key ^ data) != hash)
+        return false;
+    first_child = static_cast<NodeIdx>(data & 0xffffffffu);
+    nu_children = static_cast<unsigned>(data >> 32);
+    return true;
+}
+
+template<bool MT>
+inline void TranspositionTable<MT>::store(Hash hash, NodeIdx first_child,
+                                          unsigned nu_children)
+{
+    LIBBOARDGAME_ASSERT(nu_children > 0);
+    if (! m_entries)
+        return;
+    auto& entry = m_entries[hash & m_mask];
+    Hash data = (static_cast<Hash>(nu_children) << 32) | first_child;
+    entry.key.store(hash ^ data, memory_order_relaxed);
+    entry.data.store(data, memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace libboardgame_mcts
+
+#endif // LIBBOARDGAME_MCTS_TRANSPOSITION_TABLE_H
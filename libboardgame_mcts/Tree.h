@@ -8,12 +8,26 @@
 #define LIBBOARDGAME_MCTS_TREE_H
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <istream>
 #include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "Node.h"
+#include "libboardgame_base/Memory.h"
+#include "libboardgame_base/Range.h"
 
 namespace libboardgame_mcts {
 
 using namespace std;
+using libboardgame_base::alloc_large;
 using libboardgame_base::Range;
 
 //-----------------------------------------------------------------------------
@@ -22,8 +36,13 @@ using libboardgame_base::Range;
     The nodes can be modified only through member functions of this class,
     so that it can guarantee an intact tree structure. The user has access to
     all nodes, but only as const references.<p>
-    The tree uses separate parts of the node storage for different threads,
-    so it can be used without locking in multi-threaded search. Not all
+    The node storage is handed out to the threads in chunks of nodes, which
+    are taken from a shared lock-free bump allocator whenever the current chunk
+    of a thread cannot hold the children of a node expansion. This way, the
+    whole capacity of the tree can be used by any thread, but the threads
+    still add nodes without locking in multi-threaded search. Nodes that are
+    no longer needed are removed in place by prune() or make_root(), which
+    compact the remaining nodes at the beginning of the storage. Not all
     functions are thread-safe, only the ones that are used during a search
     (e.g. expanding a node is thread-safe, but clear() is not) */
 template<typename N>
@@ -64,9 +83,22 @@ public:
         NodeExpander(unsigned thread_id, Tree& tree, Float child_min_count,
                      Float max_move_prior);
 
+        /** Create only the children with the highest move priors.
+            Used for progressive widening. If set, add_child() collects the
+            children and link_children() creates the ones with the highest
+            move priors in this order. If the node already has children
+            because it was only partially expanded, the existing children
+            are replaced by copies that keep their data and subtrees. The
+            old children are not changed because other threads can still
+            use them. Must be called before check_capacity(). */
+        void set_max_children(unsigned max_children);
+
         /** Check if the tree still has the capacity for a given number
-            of children. */
-        bool check_capacity(unsigned short nu_children) const;
+            of children.
+            Takes a new chunk of nodes for the thread if the current chunk
+            is not large enough. Must be called once before adding the
+            children. */
+        bool check_capacity(unsigned short nu_children);
 
         /** Add new child.
             It needs to be checked first with check_capacity() that the tree
@@ -74,9 +106,15 @@ public:
         void add_child(const Move& mv, Float value, Float count,
                        Float move_prior);
 
-        /** Link the children to the parent node. */
+        /** Link the children to the parent node.
+            Also sets Node::is_partially_expanded() and ends the widening if
+            the node was widened. */
         void link_children(Tree& tree, const Node& node);
 
+        /** Were children omitted because of set_max_children()?
+            Only valid after all children were added. */
+        bool is_truncated() const;
+
         /** Return the node to play after the node expansion.
             This returns the child with the highest value if prior knowledge
             was used, or the first child, or null if no children. This can be
@@ -89,6 +127,11 @@ public:
 
         Float m_best_move_prior = -numeric_limits<Float>::max();
 
+        /** See set_max_children(). 0 means no limit. */
+        unsigned m_max_children = 0;
+
+        Tree& m_tree;
+
         const Node* m_first_child;
 
         const Node* m_best_child;
@@ -114,10 +157,44 @@ public:
 
     size_t get_nu_nodes() const;
 
+    size_t get_max_nodes() const { return m_max_nodes; }
+
+    /** Was the kernel advised to back the node storage with huge pages?
+        See libboardgame_base::alloc_large(). */
+    bool is_huge_page_advised() const { return m_is_huge_page_advised; }
+
     const Node& get_node(NodeIdx i) const;
 
+    NodeIdx get_node_idx(const Node& node) const;
+
+    /** Allow nodes to share their children.
+        This is used for transpositions, which make the tree a directed
+        acyclic graph. If enabled, prune() keeps shared children only once.
+        Default is false. */
+    void set_shared_children(bool enable) { m_shared_children = enable; }
+
     void set_expanding(const Node& node) { non_const(node).set_expanding(); }
 
+    void set_proven(const Node& node, ProvenResult result)
+    {
+        non_const(node).set_proven(result);
+    }
+
+    void set_has_all_moves(const Node& node, bool enable)
+    {
+        non_const(node).set_has_all_moves(enable);
+    }
+
+    void set_partially_expanded(const Node& node, bool enable)
+    {
+        non_const(node).set_partially_expanded(enable);
+    }
+
+    bool start_widening(const Node& node)
+    {
+        return non_const(node).start_widening();
+    }
+
     void link_children(const Node& node, const Node* first_child,
                        unsigned nu_children);
 
@@ -129,57 +206,183 @@ public:
 
     void inc_visit_count(const Node& node);
 
-    void swap(Tree& tree);
-
-    /** Extract a subtree.
-        Note that you still have to re-initialize the value of the subtree
-        after the extraction because the value of the root node and the values
-        of inner nodes have a different meaning.
-        @pre Target tree is empty (! target.get_root().has_children())
-        @param target The target tree
-        @param node The root node of the subtree. */
-    void extract_subtree(Tree& target, const Node& node) const;
-
-    /** Copy a subtree.
-        The caller is responsible that the trees have the same number of
-        maximum nodes and that the target tree has room for the subtree.
-        @param target The target tree
-        @param target_node The target node
-        @param node The root node of the subtree.
-        @param min_count Don't copy subtrees of nodes below this count */
-    void copy_subtree(Tree& target, const Node& target_node, const Node& node,
-                      Float min_count) const;
+    void add_value_atomic(const Node& node, Float v);
+
+    void add_value_remove_loss_atomic(const Node& node, Float v);
+
+    void inc_visit_count_atomic(const Node& node);
+
+    /** Remove the subtrees of nodes with a low visit count.
+        The remaining nodes are compacted in place at the beginning of the
+        node storage, so no second tree is needed. This invalidates the
+        indices of all nodes apart from the root. Not thread-safe.
+        @param min_count Remove the children of all nodes apart from the
+        root that have a visit count below this value. */
+    void prune(Float min_count);
+
+    /** Make a node the new root and remove all nodes not in its subtree.
+        Works in place like prune(). Note that you still have to
+        re-initialize the value of the new root because the value of the root
+        node and the values of inner nodes have a different meaning. */
+    void make_root(const Node& node);
+
+    /** Write the tree in a compact binary format.
+        Only the nodes reachable from the root are written, in the order of a
+        breadth-first traversal, such that the children of a node are still
+        stored consecutively. The format uses the native byte order and type
+        sizes, so it can only be read by a build of the same program on the
+        same platform. Not thread-safe. */
+    void write(ostream& out) const;
+
+    /** Read a tree written with write().
+        The nodes are read in chunks directly into the node storage, so the
+        time for reading is dominated by the I/O. Not thread-safe.
+        @param in
+        @param is_valid_move A function that returns if a move is valid in
+        the current game (e.g. if it is in the range of moves of the game
+        variant). Only called for moves in the range of moves of Move and not
+        for the root. If empty, all moves in the range of moves of Move are
+        valid.
+        @throws runtime_error if the stream has an invalid format (including
+        invalid moves), the tree does not fit into the node storage or has
+        shared children but set_shared_children() is not enabled. The tree
+        is cleared if the error occurs after the header was read. */
+    void read(istream& in,
+              const function<bool(const Move&)>& is_valid_move = {});
 
 private:
+    /** Child collected by NodeExpander if the number of children is
+        limited. */
+    struct ChildCandidate
+    {
+        Move move;
+
+        Float value;
+
+        Float count;
+
+        Float move_prior;
+
+        /** Order in which the child was added. */
+        unsigned index;
+    };
+
+    /** The current chunk of nodes of a thread. */
     struct ThreadStorage
     {
-        Node* begin;
+        Node* next;
 
         Node* end;
 
-        Node* next;
+        /** Number of nodes used by this thread. */
+        size_t nu_nodes;
+
+        /** Buffer for NodeExpander::set_max_children().
+            Reused for efficiency. */
+        vector<ChildCandidate> candidates;
     };
 
+    /** Deleter for the node storage allocated with alloc_large(). */
+    struct FreeNodes
+    {
+        void operator()(Node* nodes) { free(nodes); }
+    };
+
+    /** The children of a node that are kept by prune(). */
+    struct ChildrenBlock
+    {
+        NodeIdx first_child;
+
+        NodeIdx nu_children;
+
+        /** Index of the first child after the compaction. */
+        NodeIdx new_first_child;
+    };
+
+    /** Fixed-size representation of a node used by write() and read(). */
+    struct NodeRecord
+    {
+        Float value;
+
+        Float value_count;
+
+        Float visit_count;
+
+        Float move_prior;
 
-    unique_ptr<Node[]> m_nodes;
+        NodeIdx first_child;
+
+        short nu_children;
+
+        Move move;
+
+        ProvenResult proven;
+
+        bool has_all_moves;
+
+        bool is_partially_expanded;
+    };
+
+    static_assert(is_trivially_copyable_v<NodeRecord>);
+
+    /** Identifier at the beginning of the binary format. */
+    static constexpr char file_id[8] =
+        { 'L', 'B', 'G', 'M', 'T', 'R', 'E', 'E' };
+
+    /** Version of the binary format. */
+    static constexpr uint_least32_t file_version = 2;
+
+    /** Number of nodes read or written at once. */
+    static constexpr size_t io_chunk_size = 65536;
+
+
+    unique_ptr<Node[], FreeNodes> m_nodes;
+
+    /** See is_huge_page_advised() */
+    bool m_is_huge_page_advised;
 
     unique_ptr<ThreadStorage[]> m_thread_storage;
 
     unsigned m_nu_threads;
 
+    /** See set_shared_children() */
+    bool m_shared_children = false;
+
     size_t m_max_nodes;
 
-    size_t m_nodes_per_thread;
+    /** Default number of nodes in a chunk. */
+    size_t m_chunk_size;
+
+    /** Number of nodes at the beginning of m_nodes already handed out. */
+    atomic<size_t> m_nu_allocated;
 
 
     bool contains(const Node& node) const;
 
-    void copy_recurse(Tree& target, const Node& target_node, const Node& node,
-                      Float min_count) const;
+    /** Check if a move read by read() is in the range of moves.
+        Uses the integer representation of the move directly because Move
+        might assert that its value is valid. */
+    static bool is_in_move_range(const Move& mv);
+
+    /** Get the index of a children block after the compaction in prune().
+        @param blocks The kept children blocks sorted by first child. */
+    static NodeIdx get_new_first_child(const vector<ChildrenBlock>& blocks,
+                                       NodeIdx first_child);
 
-    unsigned get_thread_storage(const Node& node) const;
+    /** Take a new chunk for a thread.
+        @return false if the tree has not enough capacity left. */
+    bool get_chunk(ThreadStorage& thread_storage, size_t min_size);
 
     Node& non_const(const Node& node) const;
+
+    /** Call a function for all nodes reachable from the root in the order
+        used by write().
+        The function is called with the node and the index of its first child
+        in the written tree (0 if the node has no children). Shared children
+        are visited only once.
+        @return The number of nodes visited. */
+    template<typename F>
+    size_t for_each_reachable(F f) const;
 };
 
 template<typename N>
@@ -187,6 +390,7 @@ inline Tree<N>::NodeExpander::NodeExpander(
         unsigned thread_id, Tree& tree, [[maybe_unused]] Float child_min_count,
         [[maybe_unused]] Float max_move_prior)
     : m_thread_storage(tree.m_thread_storage[thread_id]),
+      m_tree(tree),
       m_first_child(m_thread_storage.next),
       m_best_child(nullptr)
 {
@@ -205,6 +409,13 @@ inline void Tree<N>::NodeExpander::add_child(const Move& mv, Float value,
     LIBBOARDGAME_ASSERT(value > -numeric_limits<Float>::max());
     LIBBOARDGAME_ASSERT(count >= m_child_min_count);
     LIBBOARDGAME_ASSERT(move_prior <= m_max_move_prior);
+    if (m_max_children > 0)
+    {
+        auto& candidates = m_thread_storage.candidates;
+        candidates.push_back({mv, value, count, move_prior,
+                              static_cast<unsigned>(candidates.size())});
+        return;
+    }
     auto& next = m_thread_storage.next;
     LIBBOARDGAME_ASSERT(next < m_thread_storage.end);
     next->init(mv, value, count, move_prior);
@@ -214,13 +425,39 @@ inline void Tree<N>::NodeExpander::add_child(const Move& mv, Float value,
         m_best_move_prior = move_prior;
     }
     ++next;
+    ++m_thread_storage.nu_nodes;
 }
 
 template<typename N>
-inline bool Tree<N>::NodeExpander::check_capacity(
-        unsigned short nu_children) const
+inline bool Tree<N>::NodeExpander::is_truncated() const
 {
-    return m_thread_storage.end - m_thread_storage.next  >= nu_children;
+    return m_max_children > 0
+            && m_thread_storage.candidates.size() > m_max_children;
+}
+
+template<typename N>
+inline void Tree<N>::NodeExpander::set_max_children(unsigned max_children)
+{
+    LIBBOARDGAME_ASSERT(max_children > 0);
+    m_max_children = max_children;
+    m_thread_storage.candidates.clear();
+}
+
+template<typename N>
+inline bool Tree<N>::NodeExpander::check_capacity(unsigned short nu_children)
+{
+    if (m_max_children > 0)
+    {
+        m_thread_storage.candidates.reserve(nu_children);
+        nu_children = static_cast<unsigned short>(
+                    min(static_cast<unsigned>(nu_children), m_max_children));
+    }
+    if (m_thread_storage.end - m_thread_storage.next >= nu_children)
+        return true;
+    if (! m_tree.get_chunk(m_thread_storage, nu_children))
+        return false;
+    m_first_child = m_thread_storage.next;
+    return true;
 }
 
 template<typename N>
@@ -241,6 +478,49 @@ inline auto Tree<N>::get_children(const Node& node) const -> Children
     return Children(nullptr, nullptr);
 }
 
+template<typename N>
+template<typename F>
+size_t Tree<N>::for_each_reachable(F f) const
+{
+    // Children blocks in the order they are written. The block of the root
+    // is the root itself.
+    vector<ChildrenBlock> blocks;
+    unordered_map<NodeIdx, NodeIdx> shared;
+    blocks.push_back({0, 1, 0});
+    size_t nu_nodes = 1;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        auto block = blocks[i];
+        for (NodeIdx j = 0; j < block.nu_children; ++j)
+        {
+            auto& node = m_nodes[block.first_child + j];
+            auto nu_children = node.get_nu_children();
+            NodeIdx new_first_child = 0;
+            if (nu_children > 0)
+            {
+                auto first_child = node.get_first_child();
+                auto pos = shared.end();
+                if (m_shared_children)
+                    pos = shared.find(first_child);
+                if (pos != shared.end())
+                    new_first_child = pos->second;
+                else
+                {
+                    new_first_child = static_cast<NodeIdx>(nu_nodes);
+                    if (m_shared_children)
+                        shared.emplace(first_child, new_first_child);
+                    blocks.push_back({first_child,
+                                      static_cast<NodeIdx>(nu_children),
+                                      new_first_child});
+                    nu_nodes += static_cast<size_t>(nu_children);
+                }
+            }
+            f(node, new_first_child);
+        }
+    }
+    return nu_nodes;
+}
+
 template<typename N>
 inline auto Tree<N>::get_node(NodeIdx i) const -> const Node&
 {
@@ -248,8 +528,75 @@ inline auto Tree<N>::get_node(NodeIdx i) const -> const Node&
 }
 
 template<typename N>
-inline void Tree<N>::NodeExpander::link_children(Tree& tree, const Node& node)
+void Tree<N>::NodeExpander::link_children(Tree& tree, const Node& node)
 {
+    if (m_max_children > 0)
+    {
+        auto& candidates = m_thread_storage.candidates;
+        auto nu_candidates = static_cast<unsigned>(candidates.size());
+        auto nu_children = min(nu_candidates, m_max_children);
+        // Existing children of a partially expanded node are the first ones
+        // in the same order unless gen_children() generated different moves
+        auto old_children = tree.get_children(node);
+        if (! old_children.empty() && nu_children <= old_children.size())
+        {
+            // No more children can be created, this also ends the widening
+            // started with Node::start_widening()
+            tree.set_partially_expanded(node,
+                                        nu_candidates > old_children.size());
+            return;
+        }
+        // Sorting is not needed if all children are created for the first
+        // time
+        if (nu_candidates > nu_children || ! old_children.empty())
+        {
+            auto cmp = [](const ChildCandidate& c1, const ChildCandidate& c2) {
+                if (c1.move_prior != c2.move_prior)
+                    return c1.move_prior > c2.move_prior;
+                return c1.index < c2.index;
+            };
+            auto end = candidates.begin() + nu_children;
+            nth_element(candidates.begin(), end, candidates.end(), cmp);
+            sort(candidates.begin(), end, cmp);
+        }
+        auto& next = m_thread_storage.next;
+        LIBBOARDGAME_ASSERT(m_thread_storage.end - next >= nu_children);
+        for (unsigned i = 0; i < nu_children; ++i)
+        {
+            auto& c = candidates[i];
+            const Node* old_child = nullptr;
+            if (i < old_children.size()
+                    && old_children.begin()[i].get_move() == c.move)
+                old_child = &old_children.begin()[i];
+            else
+                for (auto& j : old_children)
+                    if (j.get_move() == c.move)
+                    {
+                        old_child = &j;
+                        break;
+                    }
+            if (old_child != nullptr)
+                next->copy_from(*old_child);
+            else
+                next->init(c.move, c.value, c.count, c.move_prior);
+            if (c.move_prior > m_best_move_prior)
+            {
+                m_best_child = next;
+                m_best_move_prior = c.move_prior;
+            }
+            ++next;
+        }
+        m_thread_storage.nu_nodes += nu_children;
+        if (! old_children.empty())
+        {
+            tree.link_children(node, m_first_child, nu_children);
+            // Only after linking, such that a thread that widens the node
+            // next copies the new children
+            tree.set_partially_expanded(node, is_truncated());
+            return;
+        }
+        tree.set_partially_expanded(node, is_truncated());
+    }
     auto nu_children =
             static_cast<unsigned>(m_thread_storage.next - m_first_child);
     tree.link_children(node, m_first_child, nu_children);
@@ -270,21 +617,25 @@ Tree<N>::Tree(size_t memory, unsigned nu_threads)
         min(max_nodes, static_cast<size_t>(numeric_limits<NodeIdx>::max()));
     m_nu_threads = nu_threads;
     m_max_nodes = max_nodes;
-
-    // Using make_unique<Node[]>(max_nodes) slows down the array creation and
-    // thereby the startup time of Pentobi with GCC 7/8 because the compiler
-    // does not optimize away the call to the empty Move() constructor (last
-    // tested with GCC 7.2.0 and GCC 8.0.0 on Ubuntu 17.10).
-    m_nodes.reset(new Node[max_nodes]);
+    // Chunks should be small enough to not waste much memory at the end of
+    // the storage but large enough that threads rarely need a new chunk
+    m_chunk_size = max(min(max_nodes / (16 * nu_threads), size_t(1) << 14),
+                       size_t(1));
+
+    // The nodes are default-initialized, which does not write to the memory
+    // because Node has no data member initializers and an empty Move()
+    // constructor. So the pages of the storage are only mapped when a thread
+    // creates nodes in them (using make_unique<Node[]>(max_nodes) would
+    // value-initialize the nodes and slow down the startup of Pentobi).
+    static_assert(is_trivially_destructible_v<Node>);
+    auto nodes = static_cast<Node*>(alloc_large(max_nodes * sizeof(Node),
+                                                m_is_huge_page_advised));
+    if (nodes == nullptr)
+        throw bad_alloc();
+    m_nodes.reset(nodes);
+    uninitialized_default_construct_n(nodes, max_nodes);
 
     m_thread_storage = make_unique<ThreadStorage[]>(nu_threads);
-    m_nodes_per_thread = max_nodes / nu_threads;
-    for (unsigned i = 0; i < nu_threads; ++i)
-    {
-        auto& thread_storage = m_thread_storage[i];
-        thread_storage.begin = m_nodes.get() + i * m_nodes_per_thread;
-        thread_storage.end = thread_storage.begin + m_nodes_per_thread;
-    }
     clear();
 }
 
@@ -301,74 +652,63 @@ inline void Tree<N>::add_value(const Node& node, Float v, Float weight)
 }
 
 template<typename N>
-void Tree<N>::clear()
+inline void Tree<N>::add_value_atomic(const Node& node, Float v)
 {
-    m_thread_storage[0].next = m_thread_storage[0].begin + 1;
-    for (unsigned i = 1; i < m_nu_threads; ++i)
-        m_thread_storage[i].next = m_thread_storage[i].begin;
-    m_nodes[0].init_root();
+    non_const(node).add_value_atomic(v);
 }
 
 template<typename N>
-bool Tree<N>::contains(const Node& node) const
+void Tree<N>::clear()
 {
-    return &node >= m_nodes.get() && &node < m_nodes.get() + m_max_nodes;
+    for (unsigned i = 0; i < m_nu_threads; ++i)
+    {
+        auto& thread_storage = m_thread_storage[i];
+        thread_storage.next = nullptr;
+        thread_storage.end = nullptr;
+        thread_storage.nu_nodes = 0;
+    }
+    // The root node is counted as a node of the first thread
+    m_thread_storage[0].nu_nodes = 1;
+    m_nu_allocated.store(1, memory_order_relaxed);
+    m_nodes[0].init_root();
 }
 
 template<typename N>
-void Tree<N>::copy_subtree(Tree& target, const Node& target_node,
-                           const Node& node, Float min_count) const
+bool Tree<N>::contains(const Node& node) const
 {
-    target.non_const(target_node).copy_data_from(node);
-    if (node.get_nu_children() > 0)
-        copy_recurse(target, target_node, node, min_count);
-    else
-        target.non_const(target_node).unlink_children_st();
+    return &node >= m_nodes.get() && &node < m_nodes.get() + m_max_nodes;
 }
 
 template<typename N>
-void Tree<N>::copy_recurse(Tree& target, const Node& target_node,
-                           const Node& node, Float min_count) const
+bool Tree<N>::get_chunk(ThreadStorage& thread_storage, size_t min_size)
 {
-    LIBBOARDGAME_ASSERT(target.m_max_nodes == m_max_nodes);
-    LIBBOARDGAME_ASSERT(target.m_nu_threads == m_nu_threads);
-    LIBBOARDGAME_ASSERT(contains(node));
-    LIBBOARDGAME_ASSERT(node.get_nu_children() > 0);
-    auto nu_children = static_cast<unsigned>(node.get_nu_children());
-    auto& first_child = get_node(node.get_first_child());
-    // Create target children in the equivalent thread storage as in source.
-    // This ensures that the thread storage will not overflow (because the
-    // trees have identical nu_threads/max_nodes)
-    ThreadStorage& thread_storage =
-        target.m_thread_storage[get_thread_storage(first_child)];
-    auto target_child = thread_storage.next;
-    auto target_first_child =
-        static_cast<NodeIdx>(target_child - target.m_nodes.get());
-    target.non_const(target_node).link_children_st(target_first_child,
-                                                   nu_children);
-    thread_storage.next += nu_children;
-    LIBBOARDGAME_ASSERT(thread_storage.next < thread_storage.end);
-    auto end = &first_child + nu_children;
-    for (auto i = &first_child; i != end; ++i, ++target_child)
+    // The rest of the old chunk of the thread is not used anymore
+    auto size = max(min_size, m_chunk_size);
+    auto begin = m_nu_allocated.load(memory_order_relaxed);
+    size_t end;
+    do
     {
-        target_child->copy_data_from(*i);
-        if (i->get_nu_children() <= 0 || i->get_visit_count() < min_count)
-        {
-            target_child->unlink_children_st();
-            continue;
-        }
-        copy_recurse(target, *target_child, *i, min_count);
+        if (begin + min_size > m_max_nodes)
+            return false;
+        end = min(begin + size, m_max_nodes);
     }
+    while (! m_nu_allocated.compare_exchange_weak(begin, end,
+                                                  memory_order_relaxed));
+    thread_storage.next = m_nodes.get() + begin;
+    thread_storage.end = m_nodes.get() + end;
+    return true;
 }
 
 template<typename N>
-void Tree<N>::extract_subtree(Tree& target, const Node& node) const
+inline NodeIdx Tree<N>::get_new_first_child(
+        const vector<ChildrenBlock>& blocks, NodeIdx first_child)
 {
-    LIBBOARDGAME_ASSERT(contains(node));
-    LIBBOARDGAME_ASSERT(&target != this);
-    LIBBOARDGAME_ASSERT(target.m_max_nodes == m_max_nodes);
-    LIBBOARDGAME_ASSERT(target.get_root().get_nu_children() <= 0);
-    copy_subtree(target, target.m_nodes[0], node, 0);
+    auto pos = lower_bound(blocks.begin(), blocks.end(), first_child,
+                           [](const ChildrenBlock& b, NodeIdx i) {
+                               return b.first_child < i;
+                           });
+    LIBBOARDGAME_ASSERT(pos != blocks.end() && pos->first_child == first_child);
+    return pos->new_first_child;
 }
 
 template<typename N>
@@ -376,25 +716,21 @@ size_t Tree<N>::get_nu_nodes() const
 {
     size_t result = 0;
     for (unsigned i = 0; i < m_nu_threads; ++i)
-    {
-        auto& thread_storage = m_thread_storage[i];
-        result += thread_storage.next - thread_storage.begin;
-    }
+        result += m_thread_storage[i].nu_nodes;
     return result;
 }
 
 template<typename N>
-inline auto Tree<N>::get_root() const -> const Node&
+inline NodeIdx Tree<N>::get_node_idx(const Node& node) const
 {
-    return m_nodes[0];
+    LIBBOARDGAME_ASSERT(contains(node));
+    return static_cast<NodeIdx>(&node - m_nodes.get());
 }
 
-/** Get the thread storage a node belongs to. */
 template<typename N>
-inline unsigned Tree<N>::get_thread_storage(const Node& node) const
+inline auto Tree<N>::get_root() const -> const Node&
 {
-    size_t diff = &node - m_nodes.get();
-    return static_cast<unsigned>(diff / m_nodes_per_thread);
+    return m_nodes[0];
 }
 
 template<typename N>
@@ -403,16 +739,131 @@ inline void Tree<N>::inc_visit_count(const Node& node)
     non_const(node).inc_visit_count();
 }
 
+template<typename N>
+inline void Tree<N>::inc_visit_count_atomic(const Node& node)
+{
+    non_const(node).inc_visit_count_atomic();
+}
+
 template<typename N>
 inline void Tree<N>::link_children(const Node& node, const Node* first_child,
                                    unsigned nu_children)
 {
-    auto first_child_idx = static_cast<NodeIdx>(first_child - m_nodes.get());
-    LIBBOARDGAME_ASSERT(first_child_idx > 0);
-    LIBBOARDGAME_ASSERT(first_child_idx < m_max_nodes);
+    // first_child is undefined if the node has no children (terminal
+    // position)
+    NodeIdx first_child_idx = 0;
+    if (nu_children > 0)
+    {
+        first_child_idx = static_cast<NodeIdx>(first_child - m_nodes.get());
+        LIBBOARDGAME_ASSERT(first_child_idx > 0);
+        LIBBOARDGAME_ASSERT(first_child_idx < m_max_nodes);
+    }
     non_const(node).link_children(first_child_idx, nu_children);
 }
 
+template<typename N>
+void Tree<N>::read(istream& in,
+                   const function<bool(const Move&)>& is_valid_move)
+{
+    char id[sizeof(file_id)];
+    uint_least32_t version;
+    uint_least32_t record_size;
+    uint_least32_t shared_children;
+    uint_least64_t nu_nodes;
+    in.read(id, sizeof(id));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
+    in.read(reinterpret_cast<char*>(&shared_children),
+            sizeof(shared_children));
+    in.read(reinterpret_cast<char*>(&nu_nodes), sizeof(nu_nodes));
+    if (! in || memcmp(id, file_id, sizeof(id)) != 0
+            || version != file_version || record_size != sizeof(NodeRecord)
+            || nu_nodes == 0)
+        throw runtime_error("invalid tree format");
+    // prune() would duplicate shared children otherwise
+    if (shared_children != 0 && ! m_shared_children)
+        throw runtime_error("tree has shared children");
+    if (nu_nodes > m_max_nodes)
+        throw runtime_error("tree too large");
+    clear();
+    vector<NodeRecord> buffer(min(static_cast<size_t>(nu_nodes),
+                                  io_chunk_size));
+    size_t i = 0;
+    while (i < nu_nodes)
+    {
+        auto n = min(buffer.size(), static_cast<size_t>(nu_nodes - i));
+        in.read(reinterpret_cast<char*>(buffer.data()),
+                static_cast<streamsize>(n * sizeof(NodeRecord)));
+        if (! in)
+        {
+            clear();
+            throw runtime_error("unexpected end of tree");
+        }
+        for (size_t j = 0; j < n; ++j, ++i)
+        {
+            auto& r = buffer[j];
+            // The move of the root is not used and not initialized
+            if (i > 0 && (! is_in_move_range(r.move)
+                          || (is_valid_move && ! is_valid_move(r.move))))
+            {
+                clear();
+                throw runtime_error("invalid move in tree");
+            }
+            auto& node = m_nodes[i];
+            node.set_data(r.move, r.value, r.value_count, r.visit_count,
+                          r.move_prior, r.proven, r.has_all_moves,
+                          r.is_partially_expanded);
+            if (r.nu_children > 0)
+            {
+                // Children are always stored after their parent
+                if (r.first_child <= i
+                        || r.first_child + size_t(r.nu_children) > nu_nodes)
+                {
+                    clear();
+                    throw runtime_error("invalid tree format");
+                }
+                node.link_children_st(r.first_child,
+                                      static_cast<unsigned>(r.nu_children));
+            }
+            else if (r.nu_children == 0)
+                node.link_children(0, 0);
+            else
+                node.unlink_children_st();
+        }
+    }
+    m_thread_storage[0].nu_nodes = nu_nodes;
+    m_nu_allocated.store(nu_nodes, memory_order_relaxed);
+}
+
+template<typename N>
+bool Tree<N>::is_in_move_range(const Move& mv)
+{
+    using IntType = decltype(mv.to_int());
+    static_assert(sizeof(Move) == sizeof(IntType));
+    static_assert(is_trivially_copyable_v<Move>);
+    IntType i;
+    memcpy(&i, &mv, sizeof(i));
+    return static_cast<make_unsigned_t<IntType>>(i) < Move::range;
+}
+
+template<typename N>
+void Tree<N>::make_root(const Node& node)
+{
+    LIBBOARDGAME_ASSERT(contains(node));
+    auto& root = m_nodes[0];
+    if (&node != &root)
+    {
+        root.copy_data_from(node);
+        if (node.get_nu_children() > 0)
+            root.link_children_st(
+                        node.get_first_child(),
+                        static_cast<unsigned>(node.get_nu_children()));
+        else
+            root.unlink_children_st();
+    }
+    prune(0);
+}
+
 /** Convert a const reference to node from user to a non-const reference.
     The user has only read access to the nodes, because the tree guarantees
     the validity of the tree structure. */
@@ -430,23 +881,127 @@ inline void Tree<N>::add_value_remove_loss(const Node& node, Float v)
 }
 
 template<typename N>
-void Tree<N>::swap(Tree& tree)
+inline void Tree<N>::add_value_remove_loss_atomic(const Node& node, Float v)
+{
+    non_const(node).add_value_remove_loss_atomic(v);
+}
+
+template<typename N>
+void Tree<N>::prune(Float min_count)
 {
-    // Reminder to update this function when the class gets additional members
-    struct Dummy
+    // Mark: find the children blocks reachable from the root. Without shared
+    // children, each block can be reached only once.
+    vector<ChildrenBlock> blocks;
+    vector<const Node*> stack;
+    unordered_set<NodeIdx> visited;
+    auto& root = m_nodes[0];
+    if (root.get_nu_children() > 0)
+        stack.push_back(&root);
+    while (! stack.empty())
+    {
+        auto& node = *stack.back();
+        stack.pop_back();
+        auto first_child = node.get_first_child();
+        if (m_shared_children && ! visited.insert(first_child).second)
+            continue;
+        auto nu_children = static_cast<NodeIdx>(node.get_nu_children());
+        blocks.push_back({first_child, nu_children, 0});
+        for (auto& i : get_children(node))
+            if (i.get_nu_children() > 0 && i.get_visit_count() >= min_count)
+                stack.push_back(&i);
+    }
+    // Compact: move the blocks in the order of their position to the
+    // beginning of the storage. The new position of a block is never after
+    // its old position, so no block is overwritten before it was moved.
+    sort(blocks.begin(), blocks.end(),
+         [](const ChildrenBlock& b1, const ChildrenBlock& b2) {
+             return b1.first_child < b2.first_child;
+         });
+    NodeIdx nu_nodes = 1;
+    for (auto& i : blocks)
+    {
+        i.new_first_child = nu_nodes;
+        nu_nodes += i.nu_children;
+    }
+    if (root.get_nu_children() > 0)
+        root.link_children_st(
+                    get_new_first_child(blocks, root.get_first_child()),
+                    static_cast<unsigned>(root.get_nu_children()));
+    for (auto& i : blocks)
+        for (NodeIdx j = 0; j < i.nu_children; ++j)
+        {
+            auto& node = m_nodes[i.first_child + j];
+            auto& target = m_nodes[i.new_first_child + j];
+            auto nu_children = node.get_nu_children();
+            auto keep_children =
+                    (nu_children > 0 && node.get_visit_count() >= min_count);
+            // Must be read before node is overwritten by target
+            NodeIdx first_child = (keep_children ? node.get_first_child() : 0);
+            if (&target != &node)
+                target.copy_data_from(node);
+            if (keep_children)
+                target.link_children_st(
+                            get_new_first_child(blocks, first_child),
+                            static_cast<unsigned>(nu_children));
+            else
+                target.unlink_children_st();
+        }
+    for (unsigned i = 0; i < m_nu_threads; ++i)
     {
-        unsigned m_nu_threads;
-        size_t m_max_nodes;
-        size_t m_nodes_per_thread;
-        unique_ptr<ThreadStorage> m_thread_storage;
-        unique_ptr<Node[]> m_nodes;
+        auto& thread_storage = m_thread_storage[i];
+        thread_storage.next = nullptr;
+        thread_storage.end = nullptr;
+        thread_storage.nu_nodes = 0;
+    }
+    m_thread_storage[0].nu_nodes = nu_nodes;
+    m_nu_allocated.store(nu_nodes, memory_order_relaxed);
+}
+
+template<typename N>
+void Tree<N>::write(ostream& out) const
+{
+    uint_least64_t nu_nodes = for_each_reachable([](const Node&, NodeIdx) {});
+    uint_least32_t version = file_version;
+    uint_least32_t record_size = sizeof(NodeRecord);
+    uint_least32_t shared_children = (m_shared_children ? 1 : 0);
+    out.write(file_id, sizeof(file_id));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&record_size),
+              sizeof(record_size));
+    out.write(reinterpret_cast<const char*>(&shared_children),
+              sizeof(shared_children));
+    out.write(reinterpret_cast<const char*>(&nu_nodes), sizeof(nu_nodes));
+    vector<NodeRecord> buffer;
+    buffer.reserve(min(static_cast<size_t>(nu_nodes), io_chunk_size));
+    auto flush = [&] {
+        out.write(reinterpret_cast<const char*>(buffer.data()),
+                  static_cast<streamsize>(buffer.size()
+                                          * sizeof(NodeRecord)));
+        buffer.clear();
     };
-    static_assert(sizeof(Tree) == sizeof(Dummy));
-    std::swap(m_nu_threads, tree.m_nu_threads);
-    std::swap(m_max_nodes, tree.m_max_nodes);
-    std::swap(m_nodes_per_thread, tree.m_nodes_per_thread);
-    m_thread_storage.swap(tree.m_thread_storage);
-    m_nodes.swap(tree.m_nodes);
+    for_each_reachable([&](const Node& node, NodeIdx first_child) {
+        NodeRecord r;
+        // Don't write uninitialized padding bytes
+        memset(static_cast<void*>(&r), 0, sizeof(r));
+        r.value = node.get_value();
+        r.value_count = node.get_value_count();
+        r.visit_count = node.get_visit_count();
+        r.move_prior = node.get_move_prior();
+        r.first_child = first_child;
+        // Nodes that were expanding when the search stopped are written as
+        // unexpanded
+        auto nu_children = node.get_nu_children();
+        r.nu_children = (nu_children >= 0 ? nu_children
+                                          : Node::value_unexpanded);
+        r.move = node.get_move();
+        r.proven = node.get_proven();
+        r.has_all_moves = node.has_all_moves();
+        r.is_partially_expanded = node.is_partially_expanded();
+        buffer.push_back(r);
+        if (buffer.size() == io_chunk_size)
+            flush();
+    });
+    flush();
 }
 
 //-----------------------------------------------------------------------------
@@ -6,6 +6,8 @@
 
 #include "libboardgame_mcts/Node.h"
 
+#include <thread>
+#include <vector>
 #include "libboardgame_test/Test.h"
 
 using namespace std;
@@ -34,4 +36,26 @@ LIBBOARDGAME_TEST_CASE(libboardgame_mcts_node_add_value_remove_loss)
     LIBBOARDGAME_CHECK_CLOSE(node.get_value(), 3.5f, 1e-4f);
 }
 
+/** Test that add_value_atomic() does not lose updates of concurrent
+    threads. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_node_add_value_atomic)
+{
+    libboardgame_mcts::Node<int, float, true> node;
+    node.init(0, 0.5, 0, 1);
+    vector<thread> threads;
+    for (unsigned i = 0; i < 4; ++i)
+        threads.emplace_back([&node] {
+            for (unsigned j = 0; j < 1000; ++j)
+            {
+                node.add_value_atomic(1);
+                node.inc_visit_count_atomic();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    LIBBOARDGAME_CHECK_EQUAL(node.get_value_count(), 4000.f);
+    LIBBOARDGAME_CHECK_EQUAL(node.get_visit_count(), 4000.f);
+    LIBBOARDGAME_CHECK_CLOSE(node.get_value(), 1.f, 1e-4f);
+}
+
 //-----------------------------------------------------------------------------
@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/tests/SelectChildTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libboardgame_mcts/SelectChild.h"
+
+#include <memory>
+#include "libboardgame_base/RandomGenerator.h"
+#include "libboardgame_mcts/Node.h"
+#include "libboardgame_test/Test.h"
+
+using namespace std;
+using libboardgame_base::Range;
+using libboardgame_base::RandomGenerator;
+using libboardgame_mcts::select_child_scalar;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+using Node = libboardgame_mcts::Node<int, float, true>;
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+/** Test that select_child_scalar() skips children that cannot become the
+    best child but still finds the best child. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_select_child_scalar)
+{
+    auto children = make_unique<Node[]>(3);
+    children[0].init(0, 0.5f, 100, 1);
+    children[1].init(1, 0.1f, 1, 1);
+    children[2].init(2, 0.4f, 1, 1);
+    Range<const Node> range(children.get(), children.get() + 3);
+    // Values 0.5 + 0.0001, 0.1 + 0.01, 0.4 + 0.01
+    LIBBOARDGAME_CHECK_EQUAL(select_child_scalar(range, 0.01f, 0.01f),
+                             &children[0]);
+    // Values 0.5 + 0.01, 0.1 + 1, 0.4 + 1
+    LIBBOARDGAME_CHECK_EQUAL(select_child_scalar(range, 1.f, 1.f),
+                             &children[2]);
+}
+
+#ifdef __SSE2__
+
+/** Test that select_child_sse2() selects the same child as
+    select_child_scalar() in random cases. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_select_child_sse2)
+{
+    RandomGenerator random;
+    random.set_seed(1);
+    const unsigned max_children = 300;
+    auto children = make_unique<Node[]>(max_children);
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        auto nu_children = 1 + random.generate() % max_children;
+        // Use few different values in some cases to get ties
+        bool use_ties = (i % 4 == 0);
+        for (unsigned j = 0; j < nu_children; ++j)
+        {
+            float value, count, move_prior;
+            if (use_ties)
+            {
+                value = 0.5f * float(random.generate() % 3);
+                count = float(1 + random.generate() % 3);
+                move_prior = 0.5f * float(random.generate() % 3);
+            }
+            else
+            {
+                value = random.generate_float(0, 1);
+                count = random.generate_float(1, 1000);
+                move_prior = random.generate_float(0, 1);
+            }
+            children[j].init(int(j), value, count, move_prior);
+        }
+        Range<const Node> range(children.get(),
+                                children.get() + nu_children);
+        // The move prior is at most 1 and the value count at least 1, so the
+        // exploration term is at most expl_factor
+        auto expl_factor = random.generate_float(0.01f, 10);
+        LIBBOARDGAME_CHECK_EQUAL(
+                    libboardgame_mcts::select_child_sse2(range, expl_factor),
+                    select_child_scalar(range, expl_factor, expl_factor));
+    }
+}
+
+#endif // __SSE2__
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/tests/ThreadPoolTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libboardgame_mcts/ThreadPool.h"
+
+#include "libboardgame_test/Test.h"
+
+using namespace std;
+using libboardgame_mcts::ThreadPool;
+
+//-----------------------------------------------------------------------------
+
+/** Test that each task is run exactly once. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_thread_pool_run)
+{
+    ThreadPool pool;
+    pool.reserve(3);
+    LIBBOARDGAME_CHECK_EQUAL(pool.get_nu_threads(), 3u);
+    vector<atomic<unsigned>> counts(100);
+    vector<ThreadPool::Task> tasks;
+    for (auto& i : counts)
+    {
+        i.store(0);
+        tasks.emplace_back([&i] { ++i; });
+    }
+    for (unsigned i = 0; i < 10; ++i)
+        pool.run(tasks);
+    for (auto& i : counts)
+        LIBBOARDGAME_CHECK_EQUAL(i.load(), 10u);
+}
+
+/** Test that run() works if the pool has no worker threads. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_thread_pool_no_threads)
+{
+    ThreadPool pool;
+    unsigned count = 0;
+    vector<ThreadPool::Task> tasks(5, [&count] { ++count; });
+    pool.run(tasks);
+    LIBBOARDGAME_CHECK_EQUAL(count, 5u);
+}
+
+//-----------------------------------------------------------------------------
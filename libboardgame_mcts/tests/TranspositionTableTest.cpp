@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/tests/TranspositionTableTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libboardgame_mcts/TranspositionTable.h"
+
+#include "libboardgame_test/Test.h"
+
+using namespace std;
+using libboardgame_mcts::NodeIdx;
+using libboardgame_mcts::TranspositionTable;
+
+//-----------------------------------------------------------------------------
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_transposition_table_lookup)
+{
+    TranspositionTable<true> table(1000);
+    LIBBOARDGAME_CHECK_EQUAL(table.get_size(), 512u);
+    NodeIdx first_child;
+    unsigned nu_children;
+    LIBBOARDGAME_CHECK(! table.lookup(12345, first_child, nu_children));
+    table.store(12345, 17, 3);
+    LIBBOARDGAME_CHECK(table.lookup(12345, first_child, nu_children));
+    LIBBOARDGAME_CHECK_EQUAL(first_child, 17u);
+    LIBBOARDGAME_CHECK_EQUAL(nu_children, 3u);
+    // Same index but different hash
+    LIBBOARDGAME_CHECK(! table.lookup(12345 + 512, first_child, nu_children));
+    table.clear();
+    LIBBOARDGAME_CHECK(! table.lookup(12345, first_child, nu_children));
+}
+
+/** Test that a table of size 0 can be used and never finds an entry. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_transposition_table_empty)
+{
+    TranspositionTable<false> table;
+    LIBBOARDGAME_CHECK_EQUAL(table.get_size(), 0u);
+    table.store(12345, 17, 3);
+    NodeIdx first_child;
+    unsigned nu_children;
+    LIBBOARDGAME_CHECK(! table.lookup(12345, first_child, nu_children));
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,346 @@
+//-----------------------------------------------------------------------------
+/** @file libboardgame_mcts/tests/TreeTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libboardgame_mcts/Tree.h"
+
+#include <sstream>
+#include "libboardgame_test/Test.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/** Minimal move type.
+    Provides the members used by the assertions in Node. */
+struct Move
+{
+    static constexpr unsigned range = 100;
+
+    int value;
+
+    Move() = default;
+
+    Move(int v) : value(v) { }
+
+    operator int() const { return value; }
+
+    int to_int() const { return value; }
+
+    static Move null() { return Move(0); }
+};
+
+using Node = libboardgame_mcts::Node<Move, float, false>;
+
+using Tree = libboardgame_mcts::Tree<Node>;
+
+void expand(Tree& tree, unsigned thread_id, const Node& node,
+            initializer_list<int> moves)
+{
+    Tree::NodeExpander expander(thread_id, tree, 0, 1);
+    auto nu_children = static_cast<unsigned short>(moves.size());
+    LIBBOARDGAME_CHECK(expander.check_capacity(nu_children));
+    for (auto mv : moves)
+        expander.add_child(mv, 0.5, 0, 0);
+    expander.link_children(tree, node);
+}
+
+/** Create a tree with the children of the root and the children of the
+    second child of the root in the chunks of different threads, so that
+    there are unused nodes between them. */
+void init_tree(Tree& tree)
+{
+    expand(tree, 1, tree.get_root(), {1, 2, 3});
+    auto& child2 = tree.get_root_children().begin()[1];
+    auto& child3 = tree.get_root_children().begin()[2];
+    expand(tree, 0, child2, {4, 5});
+    expand(tree, 0, child3, {6, 7});
+    tree.inc_visit_count(child2);
+}
+
+/** Add 4 children with different move priors.
+    The order of the move priors is 2, 4, 3, 1. */
+void add_children(Tree::NodeExpander& expander)
+{
+    LIBBOARDGAME_CHECK(expander.check_capacity(4));
+    expander.add_child(1, 0.5, 0, 0.1f);
+    expander.add_child(2, 0.5, 0, 0.4f);
+    expander.add_child(3, 0.5, 0, 0.2f);
+    expander.add_child(4, 0.5, 0, 0.3f);
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+/** Test that only the children with the highest move priors are created
+    if the number of children is limited and that creating more children
+    later replaces the children by copies. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_max_children)
+{
+    Tree tree(1000 * sizeof(Node), 1);
+    auto& root = tree.get_root();
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(2);
+        add_children(expander);
+        expander.link_children(tree, root);
+        LIBBOARDGAME_CHECK_EQUAL(expander.get_best_child()->get_move(), 2);
+    }
+    LIBBOARDGAME_CHECK(root.is_partially_expanded());
+    // No nodes are used for the missing children
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 3u);
+    auto old_children = tree.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(old_children.size(), 2u);
+    LIBBOARDGAME_CHECK_EQUAL(old_children.begin()[0].get_move(), 2);
+    LIBBOARDGAME_CHECK_EQUAL(old_children.begin()[1].get_move(), 4);
+    tree.inc_visit_count(old_children.begin()[1]);
+    expand(tree, 0, old_children.begin()[1], {5});
+    LIBBOARDGAME_CHECK(tree.start_widening(root));
+    // Only one thread can widen the node
+    LIBBOARDGAME_CHECK(! tree.start_widening(root));
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(8);
+        add_children(expander);
+        expander.link_children(tree, root);
+    }
+    LIBBOARDGAME_CHECK(! root.is_partially_expanded());
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 8u);
+    auto children = tree.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(children.size(), 4u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[0].get_move(), 2);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[1].get_move(), 4);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[2].get_move(), 3);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[3].get_move(), 1);
+    LIBBOARDGAME_CHECK_CLOSE(children.begin()[1].get_visit_count(), 1.f,
+                             1e-4f);
+    auto grand_children = tree.get_children(children.begin()[1]);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.size(), 1u);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.begin()[0].get_move(), 5);
+    // The old children are unchanged for threads that still use them
+    LIBBOARDGAME_CHECK_EQUAL(old_children.begin()[1].get_move(), 4);
+    LIBBOARDGAME_CHECK(tree.get_children(old_children.begin()[1]).begin()
+                       == grand_children.begin());
+    // prune() removes the old children
+    tree.prune(0);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 6u);
+}
+
+/** Test that a widening that could not create more children ends the
+    widening, so that the node can be widened again. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_max_children_no_widening)
+{
+    Tree tree(1000 * sizeof(Node), 1);
+    auto& root = tree.get_root();
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(2);
+        add_children(expander);
+        expander.link_children(tree, root);
+    }
+    LIBBOARDGAME_CHECK(tree.start_widening(root));
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(2);
+        add_children(expander);
+        expander.link_children(tree, root);
+    }
+    LIBBOARDGAME_CHECK(root.is_partially_expanded());
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_root_children().size(), 2u);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 3u);
+    LIBBOARDGAME_CHECK(tree.start_widening(root));
+}
+
+/** Test that a child that is widened by another thread while its parent is
+    widened is copied as partially expanded.
+    The other thread links the new children to the old child, so the copy
+    must be widened again. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_max_children_concurrent)
+{
+    Tree tree(1000 * sizeof(Node), 1);
+    auto& root = tree.get_root();
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(2);
+        add_children(expander);
+        expander.link_children(tree, root);
+    }
+    auto& old_child = tree.get_root_children().begin()[0];
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(2);
+        add_children(expander);
+        expander.link_children(tree, old_child);
+    }
+    LIBBOARDGAME_CHECK(tree.start_widening(old_child));
+    LIBBOARDGAME_CHECK(tree.start_widening(root));
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(4);
+        add_children(expander);
+        expander.link_children(tree, root);
+    }
+    auto& child = tree.get_root_children().begin()[0];
+    LIBBOARDGAME_CHECK(&child != &old_child);
+    LIBBOARDGAME_CHECK(child.is_partially_expanded());
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_children(child).size(), 2u);
+    LIBBOARDGAME_CHECK(tree.start_widening(child));
+}
+
+/** Test that write() and read() keep the partially expanded state. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_write_read_partially_expanded)
+{
+    Tree tree(1000 * sizeof(Node), 1);
+    {
+        Tree::NodeExpander expander(0, tree, 0, 1);
+        expander.set_max_children(1);
+        add_children(expander);
+        expander.link_children(tree, tree.get_root());
+    }
+    expand(tree, 0, tree.get_root_children().begin()[0], {5, 6});
+    ostringstream out;
+    tree.write(out);
+    Tree tree2(1000 * sizeof(Node), 1);
+    istringstream in(out.str());
+    tree2.read(in);
+    LIBBOARDGAME_CHECK_EQUAL(tree2.get_nu_nodes(), 4u);
+    LIBBOARDGAME_CHECK(tree2.get_root().is_partially_expanded());
+    auto children = tree2.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(children.size(), 1u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[0].get_move(), 2);
+    LIBBOARDGAME_CHECK(! children.begin()[0].is_partially_expanded());
+    LIBBOARDGAME_CHECK_EQUAL(tree2.get_children(children.begin()[0]).size(),
+                             2u);
+}
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_prune)
+{
+    Tree tree(1000 * sizeof(Node), 2);
+    init_tree(tree);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 8u);
+    tree.prune(1);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 6u);
+    auto children = tree.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(children.size(), 3u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[0].get_move(), 1);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[1].get_move(), 2);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[2].get_move(), 3);
+    LIBBOARDGAME_CHECK_CLOSE(children.begin()[1].get_visit_count(), 1.f,
+                             1e-4f);
+    LIBBOARDGAME_CHECK(children.begin()[2].is_unexpanded());
+    auto grand_children = tree.get_children(children.begin()[1]);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.size(), 2u);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.begin()[0].get_move(), 4);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.begin()[1].get_move(), 5);
+    // The freed nodes can be used again
+    expand(tree, 1, grand_children.begin()[0], {8});
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 7u);
+}
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_make_root)
+{
+    Tree tree(1000 * sizeof(Node), 2);
+    init_tree(tree);
+    tree.make_root(tree.get_root_children().begin()[1]);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 3u);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_root().get_move(), 2);
+    auto children = tree.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(children.size(), 2u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[0].get_move(), 4);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[1].get_move(), 5);
+}
+
+/** Test that children shared by several nodes are kept only once. */
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_prune_shared_children)
+{
+    Tree tree(1000 * sizeof(Node), 1);
+    tree.set_shared_children(true);
+    expand(tree, 0, tree.get_root(), {1, 2});
+    auto& child1 = tree.get_root_children().begin()[0];
+    auto& child2 = tree.get_root_children().begin()[1];
+    expand(tree, 0, child1, {3, 4});
+    tree.link_children(child2, &tree.get_children(child1).begin()[0], 2);
+    tree.prune(0);
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_nu_nodes(), 5u);
+    LIBBOARDGAME_CHECK_EQUAL(child1.get_first_child(),
+                             child2.get_first_child());
+    LIBBOARDGAME_CHECK_EQUAL(tree.get_children(child2).begin()[1].get_move(),
+                             4);
+}
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_write_read)
+{
+    Tree tree(1000 * sizeof(Node), 2);
+    init_tree(tree);
+    auto& child3 = tree.get_root_children().begin()[2];
+    tree.set_proven(child3, libboardgame_mcts::ProvenResult::win);
+    tree.set_has_all_moves(child3, true);
+    ostringstream out;
+    tree.write(out);
+    Tree tree2(1000 * sizeof(Node), 1);
+    istringstream in(out.str());
+    tree2.read(in);
+    LIBBOARDGAME_CHECK_EQUAL(tree2.get_nu_nodes(), 8u);
+    auto children = tree2.get_root_children();
+    LIBBOARDGAME_CHECK_EQUAL(children.size(), 3u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[1].get_move(), 2);
+    LIBBOARDGAME_CHECK_CLOSE(children.begin()[1].get_visit_count(), 1.f,
+                             1e-4f);
+    LIBBOARDGAME_CHECK_CLOSE(children.begin()[1].get_value(), 0.5f, 1e-4f);
+    LIBBOARDGAME_CHECK(children.begin()[0].is_unexpanded());
+    LIBBOARDGAME_CHECK(children.begin()[2].get_proven()
+                       == libboardgame_mcts::ProvenResult::win);
+    LIBBOARDGAME_CHECK(children.begin()[2].has_all_moves());
+    auto grand_children = tree2.get_children(children.begin()[2]);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.size(), 2u);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.begin()[0].get_move(), 6);
+    LIBBOARDGAME_CHECK_EQUAL(grand_children.begin()[1].get_move(), 7);
+    // The read tree is compact
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[1].get_first_child(), 4u);
+    LIBBOARDGAME_CHECK_EQUAL(children.begin()[2].get_first_child(), 6u);
+}
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_read_invalid)
+{
+    Tree tree(1000 * sizeof(Node), 2);
+    init_tree(tree);
+    ostringstream out;
+    tree.write(out);
+    auto s = out.str();
+    Tree tree2(5 * sizeof(Node), 1);
+    istringstream in(s);
+    LIBBOARDGAME_CHECK_THROW(tree2.read(in), runtime_error);
+    Tree tree3(1000 * sizeof(Node), 1);
+    istringstream in_truncated(s.substr(0, s.size() - 1));
+    LIBBOARDGAME_CHECK_THROW(tree3.read(in_truncated), runtime_error);
+    LIBBOARDGAME_CHECK_EQUAL(tree3.get_nu_nodes(), 1u);
+    istringstream in_garbage("garbage");
+    LIBBOARDGAME_CHECK_THROW(tree3.read(in_garbage), runtime_error);
+}
+
+LIBBOARDGAME_TEST_CASE(libboardgame_mcts_tree_read_invalid_move)
+{
+    Tree tree(1000 * sizeof(Node), 2);
+    init_tree(tree);
+    ostringstream out;
+    tree.write(out);
+    auto s = out.str();
+    // Replace the move 7 of the last node, which is the last record, by a
+    // move outside the range of moves
+    Move mv(7);
+    auto pos = s.rfind(string(reinterpret_cast<const char*>(&mv), sizeof(mv)));
+    LIBBOARDGAME_CHECK(pos != string::npos);
+    mv = Move(Move::range);
+    s.replace(pos, sizeof(mv), reinterpret_cast<const char*>(&mv), sizeof(mv));
+    Tree tree2(1000 * sizeof(Node), 1);
+    istringstream in(s);
+    LIBBOARDGAME_CHECK_THROW(tree2.read(in), runtime_error);
+    LIBBOARDGAME_CHECK_EQUAL(tree2.get_nu_nodes(), 1u);
+}
+
+//-----------------------------------------------------------------------------
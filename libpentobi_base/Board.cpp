@@ -6,6 +6,7 @@
 
 #include "Board.h"
 
+#include <random>
 #include "CallistoGeometry.h"
 #include "MoveMarker.h"
 
@@ -67,6 +68,25 @@ void set_color(ostream& out, const char* esc_sequence)
 
 //-----------------------------------------------------------------------------
 
+Board::HashKeys::HashKeys()
+{
+    // Fixed seed, the keys only need to be random, not different in each run
+    mt19937_64 generator;
+    for (Color c : Color::Range(Color::range))
+    {
+        for (auto& key : point[c])
+            key = generator();
+        for (Piece::IntType i = 0; i < Piece::max_pieces; ++i)
+            for (auto& key : piece[c][Piece(i)])
+                key = generator();
+        to_play[c] = generator();
+    }
+}
+
+const Board::HashKeys Board::s_hash_keys;
+
+//-----------------------------------------------------------------------------
+
 Board::Board(Variant variant)
 {
     m_color_char[Color(0)] = 'X';
@@ -89,6 +109,9 @@ void Board::copy_from(const Board& bd)
     if (m_variant != bd.m_variant)
         init_variant(bd.m_variant);
     m_moves = bd.m_moves;
+    copy(bd.m_undo_info.begin(), bd.m_undo_info.begin() + m_moves.size(),
+         m_undo_info.begin());
+    m_nu_moves_no_undo = bd.m_nu_moves_no_undo;
     m_setup.to_play = bd.m_setup.to_play;
     m_state_base = bd.m_state_base;
     for (Color c : get_colors())
@@ -292,6 +315,8 @@ void Board::init(Variant variant, const Setup* setup)
         auto& state = m_state_color[c];
         state.forbidden.fill(false, *m_geo);
         state.is_attach_point.fill(false, *m_geo);
+        state.forbidden_bitset.clear(*m_geo);
+        state.attach_point_bitset.clear(*m_geo);
         state.pieces_left.clear();
         state.nu_onboard_pieces = 0;
         state.points = 0;
@@ -305,6 +330,7 @@ void Board::init(Variant variant, const Setup* setup)
         m_attach_points[c].clear();
     }
     m_state_base.nu_onboard_pieces_all = 0;
+    m_state_base.hash = 0;
     if (setup == nullptr)
     {
         m_setup.clear();
@@ -321,6 +347,7 @@ void Board::init(Variant variant, const Setup* setup)
                 m_state_color[c].points += m_bonus_all_pieces;
     }
     m_moves.clear();
+    m_nu_moves_no_undo = 0;
 }
 
 void Board::init_variant(Variant variant)
@@ -439,17 +466,11 @@ bool Board::is_legal(Color c, Move mv) const
     auto piece = get_move_piece(mv);
     if (! is_piece_left(c, piece))
         return false;
+    auto& state = m_state_color[c];
+    auto& mask = m_bc->get_move_mask(mv);
+    if (state.forbidden_bitset.intersects(mask))
+        return false;
     auto points = get_move_points(mv);
-    auto i = points.begin();
-    auto end = points.end();
-    bool has_attach_point = false;
-    do
-    {
-        if (m_state_color[c].forbidden[*i])
-            return false;
-        has_attach_point |= static_cast<int>(is_attach_point(*i, c));
-    }
-    while (++i != end);
     if (m_is_callisto)
     {
         if (m_state_color[c].nu_left_piece[m_one_piece] > 1
@@ -458,11 +479,12 @@ bool Board::is_legal(Color c, Move mv) const
         if (piece == m_one_piece)
             return ! m_is_center_section[*points.begin()];
     }
-    if (has_attach_point)
+    if (state.attach_point_bitset.intersects(mask))
         return true;
     if (! is_first_piece(c))
         return false;
-    i = points.begin();
+    auto i = points.begin();
+    auto end = points.end();
     unsigned n = 0;
     do
         if (is_colorless_starting_point(*i)
@@ -495,22 +517,24 @@ void Board::optimize_attach_point_lists()
 /** Place setup moves on board. */
 void Board::place_setup(const Setup& setup)
 {
+    // Setup pieces cannot be undone
+    UndoInfo undo_info;
     if (m_max_piece_size == 5)
         for (Color c : get_colors())
             for (Move mv : setup.placements[c])
-                place<5, 16>(c, mv);
+                place<5, 16>(c, mv, undo_info);
     else if (m_max_piece_size == 6)
         for (Color c : get_colors())
             for (Move mv : setup.placements[c])
-                place<6, 22>(c, mv);
+                place<6, 22>(c, mv, undo_info);
     else if (m_max_piece_size == 7)
         for (Color c : get_colors())
             for (Move mv : setup.placements[c])
-                place<7, 12>(c, mv);
+                place<7, 12>(c, mv, undo_info);
     else
         for (Color c : get_colors())
             for (Move mv : setup.placements[c])
-                place<22, 44>(c, mv);
+                place<22, 44>(c, mv, undo_info);
 }
 
 void Board::play(Color c, Move mv)
@@ -528,10 +552,12 @@ void Board::play(Color c, Move mv)
 void Board::take_snapshot()
 {
     optimize_attach_point_lists();
+    m_nu_moves_no_undo = m_moves.size();
     m_snapshot.moves_size = m_moves.size();
     m_snapshot.state_base.to_play = m_state_base.to_play;
     m_snapshot.state_base.nu_onboard_pieces_all =
         m_state_base.nu_onboard_pieces_all;
+    m_snapshot.state_base.hash = m_state_base.hash;
     m_snapshot.state_base.point_state.copy_from(m_state_base.point_state,
                                                 *m_geo);
     for (Color c : get_colors())
@@ -542,6 +568,10 @@ void Board::take_snapshot()
         snapshot_state.forbidden.copy_from(state.forbidden, *m_geo);
         snapshot_state.is_attach_point.copy_from(state.is_attach_point,
                                                  *m_geo);
+        snapshot_state.forbidden_bitset.copy_from(state.forbidden_bitset,
+                                                  *m_geo);
+        snapshot_state.attach_point_bitset.copy_from(
+                    state.attach_point_bitset, *m_geo);
         snapshot_state.pieces_left = state.pieces_left;
         snapshot_state.nu_left_piece = state.nu_left_piece;
         snapshot_state.nu_onboard_pieces = state.nu_onboard_pieces;
@@ -549,6 +579,18 @@ void Board::take_snapshot()
     }
 }
 
+void Board::undo()
+{
+    if (m_max_piece_size == 5)
+        undo<5, 16>();
+    else if (m_max_piece_size == 6)
+        undo<6, 22>();
+    else if (m_max_piece_size == 7)
+        undo<7, 12>();
+    else
+        undo<22, 44>();
+}
+
 void Board::write(ostream& out, bool mark_last_move) const
 {
     // Sort lists of left pieces by name
@@ -25,9 +25,9 @@ class MoveMarker;
 /** Blokus board.
     The implementation is speed-optimized for Monte-Carlo tree search. Only
     data that is needed during the MCTS search is computed incrementally.
-    For the same reason, it does not provide an undo function, but instead
-    a snapshot state that can can be restored quickly at the start of each
-    MCTS simulation.
+    A position can be restored either with undo(), which only reverts the
+    changes made by the last move, or with a snapshot state that can be
+    restored quickly at the start of each MCTS simulation.
 
     @note The size of this class is large because it contains large members
     that are not allocated on the heap to avoid dereferencing pointers for
@@ -130,6 +130,13 @@ public:
     /** Get number of bonus points of a color. */
     ScoreType get_bonus(Color c) const;
 
+    /** Bonus points for playing all pieces in the current game variant. */
+    ScoreType get_bonus_all_pieces() const { return m_bonus_all_pieces; }
+
+    /** Additional bonus points for playing all pieces with the one-point
+        piece as the last piece in the current game variant. */
+    ScoreType get_bonus_one_piece() const { return m_bonus_one_piece; }
+
     /** Is a point a potential attachment point for a color.
         Does not check if the point is forbidden. */
     bool is_attach_point(Point p, Color c) const;
@@ -169,6 +176,23 @@ public:
         @pre get_nu_moves() < max_game_moves */
     void play(ColorMove mv);
 
+    /** Undo the last move.
+        Reverts all changes of the board state made by the last call of
+        play(), including the color to play.
+        @pre can_undo() */
+    void undo();
+
+    /** More efficient version of undo() if maximum piece size of current
+        game variant is known at compile time. */
+    template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
+    void undo();
+
+    /** Check if the last move can be undone.
+        Moves played before the last call of init() or take_snapshot() cannot
+        be undone because these functions remove forbidden points from the
+        attach point lists. */
+    bool can_undo() const;
+
     void set_to_play(Color c);
 
     void write(ostream& out, bool mark_last_move = true) const;
@@ -225,6 +249,15 @@ public:
 
     const GridExt<bool>& is_forbidden(Color c) const;
 
+    /** Forbidden points of a color as a bitset.
+        Contains the same information as is_forbidden(Color) but allows to
+        test all points of a move at once with BoardConst::get_move_mask(). */
+    const PointBitset& get_forbidden_bitset(Color c) const;
+
+    /** Potential attachment points of a color as a bitset.
+        See get_forbidden_bitset() and is_attach_point(). */
+    const PointBitset& get_attach_point_bitset(Color c) const;
+
     /** Check that no points of move are already occupied or adjacent to own
         color.
         Does not check if the move is diagonally adjacent to an existing
@@ -344,7 +377,29 @@ public:
     /** See take_snapshot() */
     void restore_snapshot();
 
+    /** Get a Zobrist hash of the current position.
+        Includes the point states, the pieces left and the color to play.
+        The hash is updated incrementally when moves are played and is
+        restored by restore_snapshot(). */
+    uint_least64_t get_hash() const;
+
 private:
+    /** Random keys for get_hash(). */
+    struct HashKeys
+    {
+        ColorMap<array<uint_least64_t, Point::range>> point;
+
+        /** Keys for the instances of a piece.
+            The key of an instance is added when it is placed, so pieces
+            that were not played yet do not contribute to the hash. */
+        ColorMap<PieceMap<array<uint_least64_t, PieceInfo::max_instances>>>
+        piece;
+
+        ColorMap<uint_least64_t> to_play;
+
+        HashKeys();
+    };
+
     /** Color-independent part of the board state. */
     struct StateBase
     {
@@ -352,6 +407,10 @@ private:
 
         unsigned nu_onboard_pieces_all;
 
+        /** Hash of the point states and pieces left.
+            Does not include the color to play. See get_hash(). */
+        uint_least64_t hash;
+
         PointStateGrid point_state;
     };
 
@@ -362,6 +421,12 @@ private:
 
         Grid<bool> is_attach_point;
 
+        /** Same as forbidden. */
+        PointBitset forbidden_bitset;
+
+        /** Same as is_attach_point. */
+        PointBitset attach_point_bitset;
+
         PiecesLeftList pieces_left;
 
         PieceMap<uint_fast8_t> nu_left_piece;
@@ -371,6 +436,29 @@ private:
         ScoreType points;
     };
 
+    /** Information needed to undo a move. */
+    struct UndoInfo
+    {
+        /** Colors for which a point of the move was already forbidden.
+            One bit per color for each point in the order of the move
+            points. */
+        array<uint_least8_t, PieceInfo::max_size> forbidden_colors;
+
+        /** Adjacent points of the move that were not forbidden.
+            One bit for each point in the order of MoveInfoExt::begin_adj(). */
+        uint_least64_t new_forbidden_adj;
+
+        ScoreType points;
+
+        unsigned attach_points_size;
+
+        Color to_play;
+
+        /** Index of the piece in the pieces left list if no instances of the
+            piece were left after the move, otherwise unused. */
+        uint_least8_t pieces_left_index;
+    };
+
     /** Snapshot for fast restoration of a previous position. */
     struct Snapshot
     {
@@ -384,6 +472,8 @@ private:
     };
 
 
+    static const HashKeys s_hash_keys;
+
     StateBase m_state_base;
 
     ColorMap<StateColor> m_state_color;
@@ -452,6 +542,13 @@ private:
 
     ArrayList<ColorMove, max_moves> m_moves;
 
+    /** Undo information for each move in m_moves. */
+    array<UndoInfo, max_moves> m_undo_info;
+
+    /** Number of moves that cannot be undone.
+        See can_undo(). */
+    unsigned m_nu_moves_no_undo;
+
     Snapshot m_snapshot;
 
     Setup m_setup;
@@ -469,7 +566,7 @@ private:
     void optimize_attach_point_lists();
 
     template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
-    void place(Color c, Move mv);
+    void place(Color c, Move mv, UndoInfo& undo_info);
 
     void place_setup(const Setup& setup);
 
@@ -626,6 +723,11 @@ inline const Board::PiecesLeftList& Board::get_pieces_left(Color c) const
     return m_state_color[c].pieces_left;
 }
 
+inline uint_least64_t Board::get_hash() const
+{
+    return m_state_base.hash ^ s_hash_keys.to_play[m_state_base.to_play];
+}
+
 inline PointState Board::get_point_state(Point p) const
 {
     return PointState(m_state_base.point_state[p].to_int());
@@ -731,6 +833,16 @@ inline void Board::init(const Setup* setup)
     init(m_variant, setup);
 }
 
+inline const PointBitset& Board::get_attach_point_bitset(Color c) const
+{
+    return m_state_color[c].attach_point_bitset;
+}
+
+inline const PointBitset& Board::get_forbidden_bitset(Color c) const
+{
+    return m_state_color[c].forbidden_bitset;
+}
+
 inline bool Board::is_attach_point(Point p, Color c) const
 {
     return m_state_color[c].is_attach_point[p];
@@ -763,14 +875,8 @@ inline const GridExt<bool>& Board::is_forbidden(Color c) const
 
 inline bool Board::is_forbidden(Color c, Move mv) const
 {
-    auto points = get_move_points(mv);
-    auto i = points.begin();
-    auto end = points.end();
-    do
-        if (m_state_color[c].forbidden[*i])
-            return true;
-    while (++i != end);
-    return false;
+    return m_state_color[c].forbidden_bitset.intersects(
+                m_bc->get_move_mask(mv));
 }
 
 inline bool Board::is_legal(Move mv) const
@@ -784,8 +890,13 @@ inline bool Board::is_piece_left(Color c, Piece piece) const
     return m_state_color[c].nu_left_piece[piece] > 0;
 }
 
+inline bool Board::can_undo() const
+{
+    return m_moves.size() > m_nu_moves_no_undo;
+}
+
 template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
-inline void Board::place(Color c, Move mv)
+inline void Board::place(Color c, Move mv, UndoInfo& undo_info)
 {
     LIBBOARDGAME_ASSERT(m_max_piece_size == MAX_SIZE);
     LIBBOARDGAME_ASSERT(m_max_adj_attach == MAX_ADJ_ATTACH);
@@ -796,9 +907,18 @@ inline void Board::place(Color c, Move mv)
     auto& state_color = m_state_color[c];
     LIBBOARDGAME_ASSERT(state_color.nu_left_piece[piece] > 0);
     auto score_points = m_score_points[piece];
-    if (--state_color.nu_left_piece[piece] == 0)
+    undo_info.points = state_color.points;
+    undo_info.attach_points_size = m_attach_points[c].size();
+    auto nu_left = --state_color.nu_left_piece[piece];
+    m_state_base.hash ^= s_hash_keys.piece[c][piece][nu_left];
+    if (nu_left == 0)
     {
-        state_color.pieces_left.remove_fast(piece);
+        auto& pieces_left = state_color.pieces_left;
+        auto pos = find(pieces_left.begin(), pieces_left.end(), piece);
+        LIBBOARDGAME_ASSERT(pos != pieces_left.end());
+        undo_info.pieces_left_index =
+                static_cast<uint_least8_t>(pos - pieces_left.begin());
+        pieces_left.remove_fast(pos);
         if (MAX_SIZE == 22) // GembloQ
         {
             LIBBOARDGAME_ASSERT(m_bonus_all_pieces == 0);
@@ -816,14 +936,22 @@ inline void Board::place(Color c, Move mv)
     ++m_state_base.nu_onboard_pieces_all;
     ++state_color.nu_onboard_pieces;
     state_color.points += score_points;
+    auto& point_keys = s_hash_keys.point[c];
     auto i = info.begin();
     auto end = info.end();
+    auto forbidden_colors = undo_info.forbidden_colors.begin();
     do
     {
         m_state_base.point_state[*i] = PointState(c);
+        m_state_base.hash ^= point_keys[i->to_int()];
+        unsigned colors = 0;
         for_each_color([&](Color c) {
-            m_state_color[c].forbidden[*i] = true;
+            auto& forbidden = m_state_color[c].forbidden[*i];
+            colors |= static_cast<unsigned>(forbidden) << c.to_int();
+            forbidden = true;
+            m_state_color[c].forbidden_bitset.set(*i);
         });
+        *(forbidden_colors++) = static_cast<uint_least8_t>(colors);
     }
     while (++i != end);
     if (MAX_SIZE == 7) // Nexos
@@ -835,8 +963,16 @@ inline void Board::place(Color c, Move mv)
     else
     {
         end = info_ext.end_adj();
-        for (i = info_ext.begin_adj(); i != end; ++i)
+        uint_least64_t new_forbidden = 0;
+        unsigned j = 0;
+        for (i = info_ext.begin_adj(); i != end; ++i, ++j)
+        {
+            new_forbidden |= static_cast<uint_least64_t>(
+                        ! state_color.forbidden[*i]) << j;
             state_color.forbidden[*i] = true;
+            state_color.forbidden_bitset.set(*i);
+        }
+        undo_info.new_forbidden_adj = new_forbidden;
         LIBBOARDGAME_ASSERT(i == info_ext.begin_attach());
         end += info_ext.size_attach_points;
     }
@@ -846,6 +982,7 @@ inline void Board::place(Color c, Move mv)
         if (! state_color.forbidden[*i] && ! state_color.is_attach_point[*i])
         {
             state_color.is_attach_point[*i] = true;
+            state_color.attach_point_bitset.set(*i);
             attach_points.get_unchecked(n) = *i;
             ++n;
         }
@@ -856,7 +993,9 @@ inline void Board::place(Color c, Move mv)
 template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
 inline void Board::play(Color c, Move mv)
 {
-    place<MAX_SIZE, MAX_ADJ_ATTACH>(c, mv);
+    auto& undo_info = m_undo_info[m_moves.size()];
+    undo_info.to_play = m_state_base.to_play;
+    place<MAX_SIZE, MAX_ADJ_ATTACH>(c, mv, undo_info);
     m_moves.push_back(ColorMove(c, mv));
     m_state_base.to_play = get_next(c);
 }
@@ -874,6 +1013,8 @@ inline void Board::restore_snapshot()
     m_state_base.to_play = m_snapshot.state_base.to_play;
     m_state_base.nu_onboard_pieces_all =
         m_snapshot.state_base.nu_onboard_pieces_all;
+    m_state_base.hash = m_snapshot.state_base.hash;
+    m_nu_moves_no_undo = m_snapshot.moves_size;
     m_state_base.point_state.memcpy_from(m_snapshot.state_base.point_state,
                                          geo);
     for (Color c : get_colors())
@@ -882,6 +1023,10 @@ inline void Board::restore_snapshot()
         auto& state = m_state_color[c];
         state.forbidden.copy_from(snapshot_state.forbidden, geo);
         state.is_attach_point.copy_from(snapshot_state.is_attach_point, geo);
+        state.forbidden_bitset.copy_from(snapshot_state.forbidden_bitset,
+                                         geo);
+        state.attach_point_bitset.copy_from(
+                    snapshot_state.attach_point_bitset, geo);
         state.pieces_left = snapshot_state.pieces_left;
         state.nu_left_piece = snapshot_state.nu_left_piece;
         state.nu_onboard_pieces = snapshot_state.nu_onboard_pieces;
@@ -890,6 +1035,70 @@ inline void Board::restore_snapshot()
     }
 }
 
+template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
+inline void Board::undo()
+{
+    LIBBOARDGAME_ASSERT(can_undo());
+    auto mv = m_moves.pop_back();
+    Color c = mv.color;
+    auto& undo_info = m_undo_info[m_moves.size()];
+    auto& state_color = m_state_color[c];
+    auto& attach_points = m_attach_points[c];
+    for (auto i = attach_points.begin() + undo_info.attach_points_size;
+         i != attach_points.end(); ++i)
+    {
+        state_color.is_attach_point[*i] = false;
+        state_color.attach_point_bitset.reset(*i);
+    }
+    attach_points.resize(undo_info.attach_points_size);
+    auto& info = BoardConst::get_move_info<MAX_SIZE>(mv.move,
+                                                     m_move_info_array);
+    auto& info_ext = BoardConst::get_move_info_ext<MAX_ADJ_ATTACH>(
+                mv.move, m_move_info_ext_array);
+    unsigned j = 0;
+    for (auto i = info_ext.begin_adj(); i != info_ext.end_adj(); ++i, ++j)
+        if ((undo_info.new_forbidden_adj & (uint_least64_t(1) << j)) != 0)
+        {
+            state_color.forbidden[*i] = false;
+            state_color.forbidden_bitset.reset(*i);
+        }
+    auto& point_keys = s_hash_keys.point[c];
+    auto forbidden_colors = undo_info.forbidden_colors.begin();
+    for (Point p : info)
+    {
+        m_state_base.point_state[p] = PointState::empty();
+        m_state_base.hash ^= point_keys[p.to_int()];
+        for_each_color([&](Color c) {
+            if ((*forbidden_colors & (1u << c.to_int())) == 0)
+            {
+                m_state_color[c].forbidden[p] = false;
+                m_state_color[c].forbidden_bitset.reset(p);
+            }
+        });
+        ++forbidden_colors;
+    }
+    auto piece = info.get_piece();
+    auto nu_left = state_color.nu_left_piece[piece]++;
+    m_state_base.hash ^= s_hash_keys.piece[c][piece][nu_left];
+    if (nu_left == 0)
+    {
+        // Revert PiecesLeftList::remove_fast() to keep the order of the list
+        auto& pieces_left = state_color.pieces_left;
+        auto index = undo_info.pieces_left_index;
+        if (index == pieces_left.size())
+            pieces_left.push_back(piece);
+        else
+        {
+            pieces_left.push_back(pieces_left[index]);
+            pieces_left[index] = piece;
+        }
+    }
+    --m_state_base.nu_onboard_pieces_all;
+    --state_color.nu_onboard_pieces;
+    state_color.points = undo_info.points;
+    m_state_base.to_play = undo_info.to_play;
+}
+
 inline void Board::set_to_play(Color c)
 {
     m_state_base.to_play = c;
@@ -7,6 +7,10 @@
 #include "BoardConst.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
 #include "Marker.h"
 #include "PieceTransformsClassic.h"
 #include "PieceTransformsGembloQ.h"
@@ -23,6 +27,80 @@ namespace {
 
 const bool log_move_creation = false;
 
+/** Version of the cache file format.
+    Must be incremented if the content of the cache file or the way the
+    moves are created changes. */
+const uint_least32_t cache_version = 1;
+
+const char cache_magic[8] = {'P', 'B', 'C', 'O', 'N', 'S', 'T', '\0'};
+
+/** Header of the cache file.
+    Contains all values that the binary layout of the tables depends on, such
+    that cache files written by a different version or build are rejected. */
+struct CacheHeader
+{
+    char magic[8];
+
+    uint_least32_t version;
+
+    /** Detects a different byte order. */
+    uint_least32_t byte_order;
+
+    uint_least32_t board_type;
+
+    uint_least32_t piece_set;
+
+    uint_least32_t adj_status_nu_adj;
+
+    uint_least32_t range;
+
+    uint_least32_t move_info_size;
+
+    uint_least32_t move_info_ext_size;
+
+    uint_least32_t move_info_ext_2_size;
+
+    uint_least32_t point_ranges_size;
+
+    uint_least32_t nu_precomp_moves;
+
+    uint_least64_t checksum;
+};
+
+/** Update a checksum with a block of data.
+    Uses the FNV-1a hash on 8-byte words, which is fast enough to not
+    significantly slow down reading the cache file. */
+void update_checksum(uint_least64_t& checksum, const void* data, size_t size)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    auto end = p + size;
+    for ( ; p + 8 <= end; p += 8)
+    {
+        uint_least64_t word;
+        memcpy(&word, p, 8);
+        checksum = (checksum ^ word) * 0x100000001b3u;
+    }
+    for ( ; p != end; ++p)
+        checksum = (checksum ^ *p) * 0x100000001b3u;
+}
+
+void write_block(ostream& out, const void* data, size_t size,
+                 uint_least64_t& checksum)
+{
+    out.write(static_cast<const char*>(data),
+              static_cast<streamsize>(size));
+    update_checksum(checksum, data, size);
+}
+
+bool read_block(istream& in, void* data, size_t size,
+                uint_least64_t& checksum)
+{
+    if (! in.read(static_cast<char*>(data), static_cast<streamsize>(size)))
+        return false;
+    update_checksum(checksum, data, size);
+    return true;
+}
+
 /** Local variable used during construction.
     Making this variable global slightly speeds up construction and a
     thread-safe construction is not needed. */
@@ -920,7 +998,11 @@ BoardConst::BoardConst(BoardType board_type, PieceSet piece_set)
     for (Point p : m_geo)
         m_compare_val[p] =
                 (height - m_geo.get_y(p) - 1) * width + m_geo.get_x(p);
-    create_moves();
+    if (s_cache_dir.empty())
+        create_moves();
+    else if (! read_cache())
+        write_cache(create_moves());
+    init_move_masks();
     switch (piece_set)
     {
     case PieceSet::classic:
@@ -950,6 +1032,13 @@ BoardConst::BoardConst(BoardType board_type, PieceSet piece_set)
         init_symmetry_info<22>();
 }
 
+unique_ptr<BoardConst> BoardConst::create(Variant variant)
+{
+    return unique_ptr<BoardConst>(
+                new BoardConst(libpentobi_base::get_board_type(variant),
+                               libpentobi_base::get_piece_set(variant)));
+}
+
 template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
 inline void BoardConst::create_move(unsigned& moves_created, Piece piece,
                                     const MovePoints& points, Point label_pos)
@@ -1028,7 +1117,7 @@ inline void BoardConst::create_move(unsigned& moves_created, Piece piece,
     }
 }
 
-void BoardConst::create_moves()
+unsigned BoardConst::create_moves()
 {
     // Unused move infos for Move::null()
     LIBBOARDGAME_ASSERT(Move::null().to_int() == 0);
@@ -1059,6 +1148,7 @@ void BoardConst::create_moves()
     }
     LIBBOARDGAME_ASSERT(moves_created == m_range);
     LIBBOARDGAME_LOG("Created moves: ", moves_created, ", precomp: ", n);
+    return n;
 }
 
 template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
@@ -1159,6 +1249,8 @@ bool BoardConst::from_string(Move& mv, const string& s) const
     return find_move(points, mv);
 }
 
+string BoardConst::s_cache_dir;
+
 const BoardConst& BoardConst::get(Variant variant)
 {
     static map<BoardType, map<PieceSet, unique_ptr<BoardConst>>> board_const;
@@ -1166,10 +1258,41 @@ const BoardConst& BoardConst::get(Variant variant)
     auto piece_set = libpentobi_base::get_piece_set(variant);
     auto& bc = board_const[board_type][piece_set];
     if (! bc)
-        bc.reset(new BoardConst(board_type, piece_set));
+        bc = create(variant);
     return *bc;
 }
 
+string BoardConst::get_cache_file() const
+{
+    return s_cache_dir + "/pentobi-boardconst-"
+            + std::to_string(static_cast<int>(m_board_type)) + "-"
+            + std::to_string(static_cast<int>(m_piece_set)) + ".dat";
+}
+
+size_t BoardConst::get_move_info_ext_size() const
+{
+    if (m_max_piece_size == 5)
+        return sizeof(MoveInfoExt<16>);
+    if (m_max_piece_size == 6)
+        return sizeof(MoveInfoExt<22>);
+    if (m_max_piece_size == 7)
+        return sizeof(MoveInfoExt<12>);
+    LIBBOARDGAME_ASSERT(m_max_piece_size == 22);
+    return sizeof(MoveInfoExt<44>);
+}
+
+size_t BoardConst::get_move_info_size() const
+{
+    if (m_max_piece_size == 5)
+        return sizeof(MoveInfo<5>);
+    if (m_max_piece_size == 6)
+        return sizeof(MoveInfo<6>);
+    if (m_max_piece_size == 7)
+        return sizeof(MoveInfo<7>);
+    LIBBOARDGAME_ASSERT(m_max_piece_size == 22);
+    return sizeof(MoveInfo<22>);
+}
+
 Piece BoardConst::get_move_piece(Move mv) const
 {
     if (m_max_piece_size == 5)
@@ -1288,6 +1411,39 @@ void BoardConst::init_adj_status_points(Point p)
     LIBBOARDGAME_ASSERT(n == max_size);
 }
 
+void BoardConst::init_move_masks()
+{
+    m_move_masks = make_unique<MoveMask[]>(m_range);
+    auto& null_mask = m_move_masks[0];
+    null_mask.first_word = 0;
+    null_mask.nu_words = 1;
+    null_mask.words[0] = 0;
+    for (Move::IntType i = 1; i < m_range; ++i)
+    {
+        auto& mask = m_move_masks[i];
+        auto points = get_move_points(Move(i));
+        unsigned first = PointBitset::nu_words;
+        unsigned last = 0;
+        for (Point p : points)
+        {
+            auto word = p.to_int() / PointBitset::bits_per_word;
+            first = min(first, word);
+            last = max(last, word);
+        }
+        LIBBOARDGAME_ASSERT(last - first < MoveMask::max_words);
+        mask.first_word = static_cast<uint_least16_t>(first);
+        mask.nu_words = static_cast<uint_least16_t>(last - first + 1);
+        for (auto& word : mask.words)
+            word = 0;
+        for (Point p : points)
+        {
+            auto j = p.to_int();
+            mask.words[j / PointBitset::bits_per_word - first] |=
+                    MoveMask::Word(1) << (j % PointBitset::bits_per_word);
+        }
+    }
+}
+
 template<unsigned MAX_SIZE>
 void BoardConst::init_symmetry_info()
 {
@@ -1318,6 +1474,63 @@ void BoardConst::init_symmetry_info()
     }
 }
 
+/** Read the move infos and precomputed moves from the cache file.
+    @return @c false if the file does not exist or is not valid. */
+bool BoardConst::read_cache()
+{
+    ifstream in(get_cache_file(), ios::binary);
+    if (! in)
+        return false;
+    CacheHeader header;
+    if (! in.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+            || header.version != cache_version
+            || header.byte_order != 0x01020304u
+            || header.board_type != static_cast<uint_least32_t>(m_board_type)
+            || header.piece_set != static_cast<uint_least32_t>(m_piece_set)
+            || header.adj_status_nu_adj != PrecompMoves::adj_status_nu_adj
+            || header.range != m_range
+            || header.move_info_size != get_move_info_size()
+            || header.move_info_ext_size != get_move_info_ext_size()
+            || header.move_info_ext_2_size != sizeof(MoveInfoExt2)
+            || header.point_ranges_size
+               != PrecompMoves::get_point_ranges_size()
+            || header.nu_precomp_moves
+               > PrecompMoves::max_move_lists_sum_length)
+    {
+        LIBBOARDGAME_LOG("Ignoring invalid cache file ", get_cache_file());
+        return false;
+    }
+    uint_least64_t checksum = 0xcbf29ce484222325u;
+    bool success =
+            read_block(in, m_move_info.get(), m_range * get_move_info_size(),
+                       checksum)
+            && read_block(in, m_move_info_ext.get(),
+                          m_range * get_move_info_ext_size(), checksum)
+            && read_block(in, m_move_info_ext_2.get(),
+                          m_range * sizeof(MoveInfoExt2), checksum)
+            && read_block(in, &m_nu_attach_points, sizeof(m_nu_attach_points),
+                          checksum);
+    for (Point p : m_geo)
+        success = success
+                && read_block(in, m_precomp_moves.get_point_ranges(p),
+                              PrecompMoves::get_point_ranges_size(), checksum);
+    success = success
+            && read_block(in, m_precomp_moves.get_move_lists(),
+                          header.nu_precomp_moves * sizeof(Move), checksum);
+    if (! success || checksum != header.checksum)
+    {
+        LIBBOARDGAME_LOG("Ignoring invalid cache file ", get_cache_file());
+        return false;
+    }
+    return true;
+}
+
+void BoardConst::set_cache_dir(const string& dir)
+{
+    s_cache_dir = dir;
+}
+
 void BoardConst::sort(MovePoints& points) const
 {
     auto less = [this](Point a, Point b)
@@ -1419,6 +1632,70 @@ string BoardConst::to_string(Move mv, bool with_piece_name) const
     return s.str();
 }
 
+/** Write the move infos and precomputed moves to the cache file.
+    The file is written to a temporary file first and then renamed to avoid
+    that concurrently started processes read a partially written file.
+    Errors are logged but otherwise ignored because the cache is optional. */
+void BoardConst::write_cache(unsigned nu_precomp_moves)
+{
+    auto file = get_cache_file();
+    auto tmp_file = file + ".tmp" + std::to_string(random_device()());
+    {
+        ofstream out(tmp_file, ios::binary);
+        CacheHeader header = {};
+        memcpy(header.magic, cache_magic, sizeof(cache_magic));
+        header.version = cache_version;
+        header.byte_order = 0x01020304u;
+        header.board_type = static_cast<uint_least32_t>(m_board_type);
+        header.piece_set = static_cast<uint_least32_t>(m_piece_set);
+        header.adj_status_nu_adj = PrecompMoves::adj_status_nu_adj;
+        header.range = m_range;
+        header.move_info_size =
+                static_cast<uint_least32_t>(get_move_info_size());
+        header.move_info_ext_size =
+                static_cast<uint_least32_t>(get_move_info_ext_size());
+        header.move_info_ext_2_size = sizeof(MoveInfoExt2);
+        header.point_ranges_size = static_cast<uint_least32_t>(
+                    PrecompMoves::get_point_ranges_size());
+        header.nu_precomp_moves = nu_precomp_moves;
+        // The header is written again when the checksum is known
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint_least64_t checksum = 0xcbf29ce484222325u;
+        write_block(out, m_move_info.get(), m_range * get_move_info_size(),
+                    checksum);
+        write_block(out, m_move_info_ext.get(),
+                    m_range * get_move_info_ext_size(), checksum);
+        write_block(out, m_move_info_ext_2.get(),
+                    m_range * sizeof(MoveInfoExt2), checksum);
+        write_block(out, &m_nu_attach_points, sizeof(m_nu_attach_points),
+                    checksum);
+        for (Point p : m_geo)
+            write_block(out, m_precomp_moves.get_point_ranges(p),
+                        PrecompMoves::get_point_ranges_size(), checksum);
+        write_block(out, m_precomp_moves.get_move_lists(),
+                    nu_precomp_moves * sizeof(Move), checksum);
+        header.checksum = checksum;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (! out)
+        {
+            LIBBOARDGAME_LOG("Error writing cache file ", tmp_file);
+            out.close();
+            remove(tmp_file.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    // On Windows, rename() fails if the destination exists
+    remove(file.c_str());
+#endif
+    if (rename(tmp_file.c_str(), file.c_str()) != 0)
+    {
+        LIBBOARDGAME_LOG("Error renaming cache file ", tmp_file);
+        remove(tmp_file.c_str());
+    }
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_base
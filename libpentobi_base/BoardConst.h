@@ -8,6 +8,7 @@
 #define LIBPENTOBI_BASE_BOARD_CONST_H
 
 #include "MoveInfo.h"
+#include "PointBitset.h"
 #include "PrecompMoves.h"
 #include "SymmetricPoints.h"
 #include "libboardgame_base/Range.h"
@@ -42,6 +43,22 @@ public:
         This function is not thread-safe. */
     static const BoardConst& get(Variant variant);
 
+    /** Create a new instance that is not shared with the instances returned
+        by get().
+        Uses the cache directory like get(). Mainly needed for testing the
+        cache. */
+    static unique_ptr<BoardConst> create(Variant variant);
+
+    /** Set a directory for caching the precomputed moves.
+        If set, the constructor reads the move infos and precomputed move
+        lists from a binary cache file in this directory if it exists and
+        matches the version, the compile-time constants and the checksum.
+        Otherwise, it creates them and writes the cache file. This makes
+        the first call of get() for a board type much faster. The default
+        is an empty string, which disables the cache. Must be called before
+        the first call of get(). */
+    static void set_cache_dir(const string& dir);
+
     template<unsigned MAX_SIZE>
     static const MoveInfo<MAX_SIZE>&
     get_move_info(Move mv, MoveInfoArray move_info_array);
@@ -92,6 +109,11 @@ public:
 
     const MoveInfoExt2* get_move_info_ext_2_array() const;
 
+    /** Get the bit masks of the move points for testing them against a
+        PointBitset.
+        Contains the same points as get_move_points(). */
+    const MoveMask& get_move_mask(Move mv) const;
+
     Move::IntType get_range() const { return m_range; }
 
     bool find_move(const MovePoints& points, Move& move) const;
@@ -193,6 +215,8 @@ private:
 
     unique_ptr<MoveInfoExt2[]> m_move_info_ext_2;
 
+    unique_ptr<MoveMask[]> m_move_masks;
+
     PrecompMoves m_precomp_moves;
 
     /** Value for comparing points using the ordering used in blksgf files.
@@ -204,22 +228,39 @@ private:
     SymmetricPoints m_symmetric_points;
 
 
+    static string s_cache_dir;
+
+
     BoardConst(BoardType board_type, PieceSet piece_set);
 
     template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
     void create_move(unsigned& moves_created, Piece piece,
                      const MovePoints& points, Point label_pos);
 
-    void create_moves();
+    /** Create the move infos and precomputed moves.
+        @return The total size of the precomputed move lists. */
+    unsigned create_moves();
 
     template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
     void create_moves(unsigned& moves_created, Piece piece);
 
+    string get_cache_file() const;
+
     template<unsigned MAX_SIZE>
     const MoveInfo<MAX_SIZE>& get_move_info(Move mv) const;
 
+    size_t get_move_info_size() const;
+
+    size_t get_move_info_ext_size() const;
+
     void init_adj_status_points(Point p);
 
+    void init_move_masks();
+
+    bool read_cache();
+
+    void write_cache(unsigned nu_precomp_moves);
+
     template<unsigned MAX_SIZE>
     void init_symmetry_info();
 };
@@ -270,6 +311,12 @@ inline const MoveInfoExt2* BoardConst::get_move_info_ext_2_array() const
     return m_move_info_ext_2.get();
 }
 
+inline const MoveMask& BoardConst::get_move_mask(Move mv) const
+{
+    LIBBOARDGAME_ASSERT(mv.to_int() < m_range);
+    return m_move_masks[mv.to_int()];
+}
+
 template<unsigned MAX_SIZE>
 inline Piece BoardConst::get_move_piece(Move mv) const
 {
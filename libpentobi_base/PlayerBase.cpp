@@ -15,6 +15,17 @@ bool PlayerBase::resign() const
     return false;
 }
 
+void PlayerBase::start_ponder([[maybe_unused]] const Board& bd,
+                              [[maybe_unused]] Color c)
+{
+    // Default implementation does nothing
+}
+
+void PlayerBase::stop_ponder()
+{
+    // Default implementation does nothing
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_base
@@ -25,6 +25,21 @@ public:
         player wants to resign in the position at the last genmove().
         The default implementation returns false. */
     virtual bool resign() const;
+
+    /** Start searching the position in the background while the opponent
+        is thinking.
+        Called after a move generated by genmove() was played. The default
+        implementation does nothing.
+        @param bd The position after the move. It is copied and does not need
+        to stay valid.
+        @param c The color to play in this position. */
+    virtual void start_ponder(const Board& bd, Color c);
+
+    /** Stop a background search started with start_ponder().
+        Must be called before the position or the player is changed. Does
+        nothing if no background search is running. The default
+        implementation does nothing. */
+    virtual void stop_ponder();
 };
 
 //-----------------------------------------------------------------------------
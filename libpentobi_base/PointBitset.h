@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+/** @file libpentobi_base/PointBitset.h
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#ifndef LIBPENTOBI_BASE_POINT_BITSET_H
+#define LIBPENTOBI_BASE_POINT_BITSET_H
+
+#include <array>
+#include <cstdint>
+#include "Geometry.h"
+
+namespace libpentobi_base {
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+
+/** Bit masks of the points of a move.
+    Contains the masks for a range of consecutive words of a PointBitset,
+    such that all points of a move can be tested with a few word operations.
+    See BoardConst::get_move_mask(). */
+struct MoveMask
+{
+    using Word = uint_least64_t;
+
+    /** Maximum number of words spanned by the points of a move.
+        The points of a piece span up to 3 words on all boards apart from
+        the GembloQ boards, which have many points per piece. */
+    static constexpr unsigned max_words = 6;
+
+    uint_least16_t first_word;
+
+    uint_least16_t nu_words;
+
+    Word words[max_words];
+};
+
+//-----------------------------------------------------------------------------
+
+/** Bitset with one bit per point.
+    Used as an alternative layout for boolean point properties in Board,
+    which allows to test all points of a move at once with a MoveMask. The
+    bit index of a point is the integer value of the point. */
+class PointBitset
+{
+public:
+    using Word = MoveMask::Word;
+
+    static constexpr unsigned bits_per_word = 64;
+
+    static constexpr unsigned nu_words =
+            (Point::range + bits_per_word - 1) / bits_per_word;
+
+    bool operator[](Point p) const;
+
+    void set(Point p);
+
+    void reset(Point p);
+
+    /** Clear the bits of all points of a geometry. */
+    void clear(const Geometry& geo);
+
+    /** Copy the bits of all points of a geometry. */
+    void copy_from(const PointBitset& bitset, const Geometry& geo);
+
+    /** Check if the bit of any point of a move mask is set. */
+    bool intersects(const MoveMask& mask) const;
+
+private:
+    array<Word, nu_words> m_words;
+
+    static unsigned get_nu_words(const Geometry& geo);
+};
+
+inline bool PointBitset::operator[](Point p) const
+{
+    auto i = p.to_int();
+    return ((m_words[i / bits_per_word] >> (i % bits_per_word)) & 1) != 0;
+}
+
+inline void PointBitset::clear(const Geometry& geo)
+{
+    auto n = get_nu_words(geo);
+    for (unsigned i = 0; i < n; ++i)
+        m_words[i] = 0;
+}
+
+inline void PointBitset::copy_from(const PointBitset& bitset,
+                                   const Geometry& geo)
+{
+    auto n = get_nu_words(geo);
+    for (unsigned i = 0; i < n; ++i)
+        m_words[i] = bitset.m_words[i];
+}
+
+inline unsigned PointBitset::get_nu_words(const Geometry& geo)
+{
+    return (geo.get_range() + bits_per_word - 1) / bits_per_word;
+}
+
+inline bool PointBitset::intersects(const MoveMask& mask) const
+{
+    auto words = m_words.data() + mask.first_word;
+    Word result = words[0] & mask.words[0];
+    for (unsigned i = 1; i < mask.nu_words; ++i)
+        result |= words[i] & mask.words[i];
+    return result != 0;
+}
+
+inline void PointBitset::set(Point p)
+{
+    auto i = p.to_int();
+    m_words[i / bits_per_word] |= Word(1) << (i % bits_per_word);
+}
+
+inline void PointBitset::reset(Point p)
+{
+    auto i = p.to_int();
+    m_words[i / bits_per_word] &= ~(Word(1) << (i % bits_per_word));
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace libpentobi_base
+
+#endif // LIBPENTOBI_BASE_POINT_BITSET_H
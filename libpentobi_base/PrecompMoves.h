@@ -92,6 +92,18 @@ public:
         during the construction. */
     const Move* move_lists_begin() const { return &(*m_move_lists.begin()); }
 
+    /** Raw storage of the list ranges at a point.
+        Only needed for reading and writing the precomputed moves from and to
+        the cache file of BoardConst. */
+    void* get_point_ranges(Point p) { return &m_moves_range[p]; }
+
+    /** Size of the storage returned by get_point_ranges(). */
+    static size_t get_point_ranges_size() { return sizeof(PointRanges); }
+
+    /** Raw storage of the move lists.
+        See get_point_ranges(). */
+    Move* get_move_lists() { return m_move_lists.data(); }
+
 private:
     class CompressedRange
     {
@@ -118,8 +130,10 @@ private:
         uint_least32_t m_val;
     };
 
+    using PointRanges = array<PieceMap<CompressedRange>, nu_adj_status>;
+
     /** See m_move_lists. */
-    Grid<array<PieceMap<CompressedRange>, nu_adj_status>> m_moves_range;
+    Grid<PointRanges> m_moves_range;
 
     /** Compact representation of lists of moves of a piece at a point
         constrained by the forbidden status of adjacent points.
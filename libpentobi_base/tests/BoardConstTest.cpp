@@ -6,12 +6,113 @@
 
 #include "libpentobi_base/BoardConst.h"
 
+#include <filesystem>
+#include <fstream>
+#include <random>
 #include "libboardgame_test/Test.h"
 
+using namespace std;
 using namespace libpentobi_base;
 
 //-----------------------------------------------------------------------------
 
+namespace {
+
+void check_equal(const BoardConst& bc1, const BoardConst& bc2)
+{
+    LIBBOARDGAME_CHECK_EQUAL(bc1.get_range(), bc2.get_range());
+    LIBBOARDGAME_CHECK_EQUAL(bc1.get_max_adj_attach(), 16u);
+    auto info_ext_array_1 = bc1.get_move_info_ext_array();
+    auto info_ext_array_2 = bc2.get_move_info_ext_array();
+    for (Move::IntType i = 1; i < bc1.get_range(); ++i)
+    {
+        Move mv(i);
+        LIBBOARDGAME_CHECK_EQUAL(bc1.to_string(mv, true),
+                                 bc2.to_string(mv, true));
+        auto& info_ext_1 =
+                BoardConst::get_move_info_ext<16>(mv, info_ext_array_1);
+        auto& info_ext_2 =
+                BoardConst::get_move_info_ext<16>(mv, info_ext_array_2);
+        LIBBOARDGAME_CHECK(equal(info_ext_1.begin_adj(),
+                                 info_ext_1.end_attach(),
+                                 info_ext_2.begin_adj(),
+                                 info_ext_2.end_attach()));
+        LIBBOARDGAME_CHECK_EQUAL(info_ext_1.size_adj_points,
+                                 info_ext_2.size_adj_points);
+        LIBBOARDGAME_CHECK_EQUAL(
+                    bc1.get_move_info_ext_2(mv).breaks_symmetry,
+                    bc2.get_move_info_ext_2(mv).breaks_symmetry);
+        LIBBOARDGAME_CHECK(bc1.get_move_info_ext_2(mv).symmetric_move
+                           == bc2.get_move_info_ext_2(mv).symmetric_move);
+    }
+    for (Piece::IntType i = 0; i < bc1.get_nu_pieces(); ++i)
+        LIBBOARDGAME_CHECK_EQUAL(bc1.get_nu_attach_points(Piece(i)),
+                                 bc2.get_nu_attach_points(Piece(i)));
+    for (Point p : bc1.get_geometry())
+        for (unsigned adj_status = 0;
+             adj_status < (1u << PrecompMoves::adj_status_nu_adj);
+             ++adj_status)
+            for (Piece::IntType i = 0; i < bc1.get_nu_pieces(); ++i)
+            {
+                auto moves_1 = bc1.get_moves(Piece(i), p, adj_status);
+                auto moves_2 = bc2.get_moves(Piece(i), p, adj_status);
+                LIBBOARDGAME_CHECK(equal(moves_1.begin(), moves_1.end(),
+                                         moves_2.begin(), moves_2.end()));
+            }
+}
+
+string read_file(const filesystem::path& file)
+{
+    ifstream in(file, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void write_file(const filesystem::path& file, const string& content)
+{
+    ofstream out(file, ios::binary);
+    out << content;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+/** Test that a BoardConst read from the cache equals a newly created one and
+    that invalid cache files are rejected and rewritten. */
+LIBBOARDGAME_TEST_CASE(pentobi_base_board_const_cache)
+{
+    auto dir = filesystem::temp_directory_path()
+            / ("pentobi-test-" + to_string(random_device()()));
+    filesystem::create_directory(dir);
+    BoardConst::set_cache_dir("");
+    auto created = BoardConst::create(Variant::duo);
+    BoardConst::set_cache_dir(dir.string());
+    BoardConst::create(Variant::duo);
+    vector<filesystem::path> files(filesystem::directory_iterator(dir), {});
+    LIBBOARDGAME_CHECK_EQUAL(files.size(), 1u);
+    auto file = files[0];
+    auto content = read_file(file);
+    // A valid file is read and not written again. A rejected file is
+    // replaced by a valid one, which changes the modification time.
+    auto old_time = filesystem::last_write_time(file) - 1h;
+    auto check_cache = [&](const string& file_content, bool is_valid) {
+        write_file(file, file_content);
+        filesystem::last_write_time(file, old_time);
+        auto bc = BoardConst::create(Variant::duo);
+        check_equal(*created, *bc);
+        LIBBOARDGAME_CHECK_EQUAL(filesystem::last_write_time(file) == old_time,
+                                 is_valid);
+        LIBBOARDGAME_CHECK(read_file(file) == content);
+    };
+    check_cache(content, true);
+    check_cache(content.substr(0, content.size() / 2), false);
+    auto wrong_checksum = content;
+    wrong_checksum.back() ^= 1;
+    check_cache(wrong_checksum, false);
+    BoardConst::set_cache_dir("");
+    filesystem::remove_all(dir);
+}
+
 /** Test that from_string() handles null moves.
     Used for example in pentobi/AnalyzeGameMode.cpp */
 LIBBOARDGAME_TEST_CASE(pentobi_base_board_const_from_string_null)
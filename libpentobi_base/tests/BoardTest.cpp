@@ -24,6 +24,45 @@ void play(Board& bd, Color c, const char* s)
     bd.play(c, mv);
 }
 
+/** Check that the bitsets of a board agree with the grids. */
+bool check_bitsets(const Board& bd)
+{
+    for (Color c : bd.get_colors())
+        for (Point p : bd)
+        {
+            if (bd.get_forbidden_bitset(c)[p] != bd.is_forbidden(p, c))
+                return false;
+            if (bd.get_attach_point_bitset(c)[p] != bd.is_attach_point(p, c))
+                return false;
+        }
+    return true;
+}
+
+/** Check that two boards have the same state. */
+bool is_same_state(const Board& bd1, const Board& bd2)
+{
+    if (bd1.get_hash() != bd2.get_hash()
+            || bd1.get_to_play() != bd2.get_to_play()
+            || bd1.get_nu_moves() != bd2.get_nu_moves()
+            || bd1.get_nu_onboard_pieces() != bd2.get_nu_onboard_pieces())
+        return false;
+    for (Color c : bd1.get_colors())
+    {
+        if (bd1.get_points(c) != bd2.get_points(c)
+                || bd1.get_pieces_left(c) != bd2.get_pieces_left(c)
+                || bd1.get_attach_points(c) != bd2.get_attach_points(c)
+                || bd1.get_nu_onboard_pieces(c)
+                   != bd2.get_nu_onboard_pieces(c))
+            return false;
+        for (Point p : bd1)
+            if (bd1.get_point_state(p) != bd2.get_point_state(p)
+                    || bd1.is_forbidden(p, c) != bd2.is_forbidden(p, c)
+                    || bd1.is_attach_point(p, c) != bd2.is_attach_point(p, c))
+                return false;
+    }
+    return check_bitsets(bd1);
+}
+
 } // namespace
 
 //-----------------------------------------------------------------------------
@@ -126,6 +165,109 @@ LIBBOARDGAME_TEST_CASE(pentobi_base_board_classic_2)
     LIBBOARDGAME_CHECK_EQUAL(bd->get_nu_onboard_pieces(Color(3)), 3u);
 }
 
+/** Check the forbidden and attach point bitsets while playing a game and
+    after restoring a snapshot. */
+LIBBOARDGAME_TEST_CASE(pentobi_base_board_bitsets)
+{
+    auto moves = make_unique<MoveList>();
+    auto marker = make_unique<MoveMarker>();
+    for (auto variant : { Variant::classic, Variant::trigon_2,
+                          Variant::nexos, Variant::callisto_2,
+                          Variant::gembloq })
+    {
+        auto bd = make_unique<Board>(variant);
+        unsigned nu_moves = 0;
+        bool is_snapshot_taken = false;
+        while (! bd->is_game_over())
+        {
+            Color c = bd->get_to_play();
+            moves->clear();
+            bd->gen_moves(c, *marker, *moves);
+            marker->clear(*moves);
+            if (moves->empty())
+            {
+                bd->set_to_play(bd->get_next(c));
+                continue;
+            }
+            bd->play(c, (*moves)[nu_moves % moves->size()]);
+            LIBBOARDGAME_CHECK(check_bitsets(*bd));
+            if (++nu_moves == 8)
+            {
+                bd->take_snapshot();
+                is_snapshot_taken = true;
+            }
+        }
+        LIBBOARDGAME_CHECK(is_snapshot_taken);
+        bd->restore_snapshot();
+        LIBBOARDGAME_CHECK_EQUAL(bd->get_nu_moves(), 8u);
+        LIBBOARDGAME_CHECK(check_bitsets(*bd));
+    }
+}
+
+/** Check that the hash does not depend on the move order and is restored
+    by restore_snapshot(). */
+LIBBOARDGAME_TEST_CASE(pentobi_base_board_hash)
+{
+    auto bd = make_unique<Board>(Variant::duo);
+    auto initial_hash = bd->get_hash();
+    bd->take_snapshot();
+    play(*bd, Color(0), "e8,e9,f9,e10");
+    play(*bd, Color(1), "j4,j5");
+    play(*bd, Color(0), "c11");
+    play(*bd, Color(1), "l2");
+    auto hash = bd->get_hash();
+    LIBBOARDGAME_CHECK(hash != initial_hash);
+    bd->restore_snapshot();
+    LIBBOARDGAME_CHECK_EQUAL(bd->get_hash(), initial_hash);
+    play(*bd, Color(0), "c11");
+    play(*bd, Color(1), "l2");
+    play(*bd, Color(0), "e8,e9,f9,e10");
+    play(*bd, Color(1), "j4,j5");
+    LIBBOARDGAME_CHECK_EQUAL(bd->get_hash(), hash);
+    bd->set_to_play(Color(1));
+    LIBBOARDGAME_CHECK(bd->get_hash() != hash);
+}
+
+/** Check that undoing moves restores the previous board state. */
+LIBBOARDGAME_TEST_CASE(pentobi_base_board_undo)
+{
+    auto moves = make_unique<MoveList>();
+    auto marker = make_unique<MoveMarker>();
+    for (auto variant : { Variant::classic, Variant::junior,
+                          Variant::trigon_2, Variant::nexos,
+                          Variant::callisto_2, Variant::gembloq })
+    {
+        auto bd = make_unique<Board>(variant);
+        auto bd2 = make_unique<Board>(variant);
+        unsigned nu_moves = 0;
+        while (! bd->is_game_over())
+        {
+            Color c = bd->get_to_play();
+            moves->clear();
+            bd->gen_moves(c, *marker, *moves);
+            marker->clear(*moves);
+            if (moves->empty())
+            {
+                bd->set_to_play(bd->get_next(c));
+                continue;
+            }
+            if (nu_moves == 8)
+                bd2->copy_from(*bd);
+            bd->play(c, (*moves)[nu_moves % moves->size()]);
+            ++nu_moves;
+        }
+        LIBBOARDGAME_CHECK(nu_moves > 8);
+        while (bd->get_nu_moves() > 8)
+        {
+            LIBBOARDGAME_CHECK(bd->can_undo());
+            bd->undo();
+        }
+        // Passes are not moves, so the color to play may differ
+        bd->set_to_play(bd2->get_to_play());
+        LIBBOARDGAME_CHECK(is_same_state(*bd, *bd2));
+    }
+}
+
 LIBBOARDGAME_TEST_CASE(pentobi_base_board_gen_moves_classic_initial)
 {
     auto bd = make_unique<Board>(Variant::classic);
@@ -296,6 +296,7 @@ void GtpEngine::genmove(Color c, Response& response)
     m_game.play(c, mv, true);
     response << bd.to_string(mv, false);
     board_changed();
+    player.start_ponder(bd, bd.get_effective_to_play());
 }
 
 Color GtpEngine::get_color_arg(Arguments args) const
@@ -340,6 +341,9 @@ PlayerBase& GtpEngine::get_player() const
 
 void GtpEngine::on_handle_cmd_begin()
 {
+    // Any command might change the position or the player
+    if (m_player != nullptr)
+        m_player->stop_ponder();
     libboardgame_base::flush_log();
 }
 
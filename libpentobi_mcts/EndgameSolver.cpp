@@ -0,0 +1,360 @@
+//-----------------------------------------------------------------------------
+/** @file libpentobi_mcts/EndgameSolver.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "EndgameSolver.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include "libboardgame_base/Log.h"
+#include "libpentobi_base/MoveMarker.h"
+
+namespace libpentobi_mcts {
+
+using libpentobi_base::BoardConst;
+using libpentobi_base::MoveList;
+using libpentobi_base::MoveMarker;
+using libpentobi_base::PrecompMoves;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/** Index of the lowest set bit.
+    Uses a De Bruijn sequence because C++17 has no portable function for
+    counting trailing zeros.
+    @pre x != 0 */
+inline unsigned get_lowest_bit(uint_least64_t x)
+{
+    static constexpr unsigned char table[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+    };
+    return table[((x & (~x + 1)) * 0x03f79d71b4cb0a89u) >> 58];
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+EndgameSolver::EndgameSolver()
+    : m_abort(false)
+{
+}
+
+void EndgameSolver::gen_moves(Color c)
+{
+    auto& state = m_state[c];
+    // Free attach points in ascending order. A move can touch several of
+    // them, it is only generated at the one with the lowest index.
+    Bitboard free_attach;
+    array<unsigned short, max_points> attach;
+    unsigned nu_attach = 0;
+    for (unsigned i = 0; i < nu_words; ++i)
+    {
+        auto w = state.attach.words[i] & ~state.forbidden.words[i];
+        free_attach.words[i] = w;
+        while (w != 0)
+        {
+            attach[nu_attach++] =
+                    static_cast<unsigned short>(64 * i + get_lowest_bit(w));
+            w &= w - 1;
+        }
+    }
+    auto is_forbidden = [&](Point p) {
+        if (p.is_null())
+            return false;
+        auto i = p.to_int();
+        return ((state.forbidden.words[i / 64] >> (i % 64)) & 1) != 0;
+    };
+    for (Piece piece : m_pieces)
+    {
+        if (state.nu_left_piece[piece] == 0)
+            continue;
+        for (unsigned j = 0; j < nu_attach; ++j)
+        {
+            auto index = attach[j];
+            Point p(index);
+            auto& adj_status_points = m_bc->get_adj_status_points(p);
+            unsigned adj_status = 0;
+            for (unsigned k = 0; k < PrecompMoves::adj_status_nu_adj; ++k)
+                adj_status |=
+                        static_cast<unsigned>(
+                            is_forbidden(adj_status_points[k])) << k;
+            for (Move mv : m_bc->get_moves(piece, p, adj_status))
+            {
+                auto& masks = m_move_masks[mv.to_int()];
+                if (masks.points.intersects(state.forbidden))
+                    continue;
+                // Skip if the move was already generated at a lower attach
+                // point
+                bool is_lowest = true;
+                for (unsigned k = 0; k <= index / 64; ++k)
+                {
+                    auto w = masks.points.words[k] & free_attach.words[k];
+                    if (k == index / 64)
+                        w &= (uint_least64_t(1) << (index % 64)) - 1;
+                    if (w != 0)
+                    {
+                        is_lowest = false;
+                        break;
+                    }
+                }
+                if (is_lowest)
+                    m_moves.push_back(mv);
+            }
+        }
+    }
+}
+
+unsigned EndgameSolver::get_nu_legal_moves(const Board& bd)
+{
+    MoveMarker marker;
+    MoveList moves;
+    unsigned n = 0;
+    for (Color c : bd.get_colors())
+    {
+        bd.gen_moves(c, marker, moves);
+        marker.clear(moves);
+        n += moves.size();
+    }
+    return n;
+}
+
+void EndgameSolver::init_variant(const Board& bd)
+{
+    m_variant = bd.get_variant();
+    m_is_initialized = true;
+    m_bonus_all_pieces = bd.get_bonus_all_pieces();
+    m_bonus_one_piece = bd.get_bonus_one_piece();
+    m_bc = &bd.get_board_const();
+    auto to_bitboard = [&](const Point* begin, const Point* end) {
+        Bitboard b;
+        b.clear();
+        for (auto i = begin; i != end; ++i)
+            if (! i->is_null())
+                b.set(i->to_int());
+        return b;
+    };
+    auto range = m_bc->get_range();
+    m_move_masks.resize(range);
+    auto move_info_ext_array = m_bc->get_move_info_ext_array();
+    for (Move::IntType i = 1; i < range; ++i)
+    {
+        Move mv(i);
+        auto& masks = m_move_masks[i];
+        auto points = m_bc->get_move_points(mv);
+        masks.points = to_bitboard(points.begin(), points.end());
+        auto& info_ext =
+                BoardConst::get_move_info_ext<16>(mv, move_info_ext_array);
+        masks.adj_points = to_bitboard(info_ext.begin_adj(),
+                                       info_ext.end_adj());
+        masks.attach_points = to_bitboard(info_ext.begin_attach(),
+                                          info_ext.end_attach());
+        masks.piece = m_bc->get_move_piece(mv);
+        masks.score_points =
+                m_bc->get_piece_info(masks.piece).get_score_points();
+    }
+    // Fixed seed, the keys only need to be random, not different in each run
+    mt19937_64 generator;
+    m_move_keys.resize(2 * size_t(range));
+    for (auto& key : m_move_keys)
+        key = generator();
+    m_pieces.clear();
+    for (Piece::IntType i = 0; i < m_bc->get_nu_pieces(); ++i)
+        m_pieces.push_back(Piece(i));
+    stable_sort(m_pieces.begin(), m_pieces.end(), [&](Piece p1, Piece p2) {
+        return m_bc->get_piece_info(p1).get_score_points()
+                > m_bc->get_piece_info(p2).get_score_points();
+    });
+    if (m_table.empty())
+        m_table.resize(table_size);
+}
+
+bool EndgameSolver::is_supported(const Board& bd)
+{
+    if (bd.get_nu_colors() != 2 || bd.get_nu_players() != 2
+            || bd.is_callisto()
+            || bd.get_board_const().get_max_piece_size() != 5
+            || bd.get_board_const().get_max_adj_attach() != 16
+            || bd.get_geometry().get_range() > max_points)
+        return false;
+    for (Color c : bd.get_colors())
+        if (bd.is_first_piece(c))
+            return false;
+    return true;
+}
+
+void EndgameSolver::play(Color c, Move mv)
+{
+    auto& masks = m_move_masks[mv.to_int()];
+    auto& state = m_state[c];
+    for (unsigned i = 0; i < nu_words; ++i)
+    {
+        m_state[Color(0)].forbidden.words[i] |= masks.points.words[i];
+        m_state[Color(1)].forbidden.words[i] |= masks.points.words[i];
+        state.forbidden.words[i] |= masks.adj_points.words[i];
+        state.attach.words[i] |= masks.attach_points.words[i];
+    }
+    state.points += masks.score_points;
+    if (--state.nu_left_piece[masks.piece] == 0
+            && --state.nu_pieces_left == 0)
+    {
+        state.points += m_bonus_all_pieces;
+        if (masks.score_points == 1)
+            state.points += m_bonus_one_piece;
+    }
+    m_hash ^= m_move_keys[2 * size_t(mv.to_int()) + c.to_int()];
+}
+
+ScoreType EndgameSolver::search(Color c, ScoreType alpha, ScoreType beta,
+                                bool is_last_pass)
+{
+    if (is_aborted())
+        return 0;
+    ++m_nu_nodes;
+    Color opp(1 - c.to_int());
+    auto begin = m_moves.size();
+    gen_moves(c);
+    auto end = m_moves.size();
+    if (begin == end)
+    {
+        if (is_last_pass)
+            return 0;
+        return -search(opp, -beta, -alpha, true);
+    }
+    auto hash = m_hash ^ (c == Color(0) ? 0 : m_move_keys[0]);
+    auto& entry = m_table[hash & (table_size - 1)];
+    if (entry.hash == hash)
+    {
+        if (entry.bound == Entry::Bound::exact)
+        {
+            m_moves.resize(begin);
+            return entry.value;
+        }
+        if (entry.bound == Entry::Bound::lower)
+            alpha = max(alpha, entry.value);
+        else
+            beta = min(beta, entry.value);
+        if (alpha >= beta)
+        {
+            m_moves.resize(begin);
+            return entry.value;
+        }
+        // Try the best move of the entry first
+        auto i = find(m_moves.begin() + static_cast<ptrdiff_t>(begin),
+                      m_moves.begin() + static_cast<ptrdiff_t>(end),
+                      entry.move);
+        if (i != m_moves.begin() + static_cast<ptrdiff_t>(end))
+            rotate(m_moves.begin() + static_cast<ptrdiff_t>(begin), i, i + 1);
+    }
+    auto old_alpha = alpha;
+    auto best_value = numeric_limits<ScoreType>::lowest();
+    auto best_move = Move::null();
+    auto old_state = m_state;
+    auto old_hash = m_hash;
+    for (auto i = begin; i != end; ++i)
+    {
+        Move mv = m_moves[i];
+        auto points_before = m_state[c].points;
+        play(c, mv);
+        auto gain = m_state[c].points - points_before;
+        auto value = gain - search(opp, gain - beta, gain - alpha, false);
+        m_state = old_state;
+        m_hash = old_hash;
+        if (is_aborted())
+            break;
+        if (value > best_value)
+        {
+            best_value = value;
+            best_move = mv;
+            if (begin == 0 && c == m_to_play)
+                m_best_move = mv;
+            if (value > alpha)
+            {
+                alpha = value;
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+    m_moves.resize(begin);
+    if (is_aborted())
+        return 0;
+    entry.hash = hash;
+    entry.value = best_value;
+    entry.move = best_move;
+    if (best_value <= old_alpha)
+        entry.bound = Entry::Bound::upper;
+    else if (best_value >= beta)
+        entry.bound = Entry::Bound::lower;
+    else
+        entry.bound = Entry::Bound::exact;
+    return best_value;
+}
+
+bool EndgameSolver::solve(const Board& bd, Color c, size_t max_nodes, Move& mv,
+                          ScoreType& score)
+{
+    LIBBOARDGAME_ASSERT(is_supported(bd));
+    if (! m_is_initialized || bd.get_variant() != m_variant)
+        init_variant(bd);
+    for (auto& entry : m_table)
+        entry.hash = 0;
+    m_hash = 1; // Avoid that the hash of the empty entries matches
+    for (Color i : bd.get_colors())
+    {
+        auto& state = m_state[i];
+        state.forbidden.clear();
+        state.attach.clear();
+        for (Point p : bd)
+        {
+            if (bd.is_forbidden(p, i))
+                state.forbidden.set(p.to_int());
+            if (bd.is_attach_point(p, i))
+                state.attach.set(p.to_int());
+        }
+        state.nu_pieces_left = 0;
+        for (Piece::IntType j = 0; j < m_bc->get_nu_pieces(); ++j)
+        {
+            Piece piece(j);
+            auto n = bd.get_nu_left_piece(i, piece);
+            state.nu_left_piece[piece] = static_cast<uint_least8_t>(n);
+            if (n > 0)
+                ++state.nu_pieces_left;
+        }
+        state.points = bd.get_points(i);
+    }
+    for (auto& move : bd.get_moves())
+        if (! move.move.is_null())
+            m_hash ^= m_move_keys[2 * size_t(move.move.to_int())
+                                  + move.color.to_int()];
+    m_moves.clear();
+    m_to_play = c;
+    m_best_move = Move::null();
+    m_max_nodes = max_nodes;
+    m_nu_nodes = 0;
+    Color opp(1 - c.to_int());
+    auto current = bd.get_points(c) - bd.get_points(opp);
+    auto value = search(c, numeric_limits<ScoreType>::lowest() / 2,
+                        numeric_limits<ScoreType>::max() / 2, false);
+    if (is_aborted())
+    {
+        LIBBOARDGAME_LOG("Endgame solver aborted after ", m_nu_nodes,
+                         " nodes");
+        return false;
+    }
+    mv = m_best_move;
+    score = current + value;
+    LIBBOARDGAME_LOG("Endgame solver score ", score, ", nodes ", m_nu_nodes);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace libpentobi_mcts
@@ -0,0 +1,236 @@
+//-----------------------------------------------------------------------------
+/** @file libpentobi_mcts/EndgameSolver.h
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#ifndef LIBPENTOBI_MCTS_ENDGAME_SOLVER_H
+#define LIBPENTOBI_MCTS_ENDGAME_SOLVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "libpentobi_base/Board.h"
+
+namespace libpentobi_mcts {
+
+using namespace std;
+using libpentobi_base::Board;
+using libpentobi_base::Color;
+using libpentobi_base::ColorMap;
+using libpentobi_base::Move;
+using libpentobi_base::Piece;
+using libpentobi_base::PieceMap;
+using libpentobi_base::Point;
+using libpentobi_base::ScoreType;
+using libpentobi_base::Variant;
+
+//-----------------------------------------------------------------------------
+
+/** Exact alpha-beta search for the end of games with two colors.
+    The position is stored in bitboards (one bit per point of the board,
+    using the integer value of the points as the bit index) with
+    precomputed bitboards for the points, adjacent points and attach points of
+    each move, so that the moves can be generated and played without the
+    overhead of Board. The search is a negamax search with alpha-beta
+    pruning and a transposition table. Moves are ordered by the best move
+    from the transposition table and then by descending piece size.
+    Currently supports the game variants with two colors and pieces of at most
+    5 points on boards of at most 256 points (Duo and Junior). */
+class EndgameSolver
+{
+public:
+    /** Check if a position is supported.
+        The variant must be supported and both colors must have played their
+        first piece. */
+    static bool is_supported(const Board& bd);
+
+    /** Get the number of legal moves of both colors.
+        Used as an estimate for the size of the remaining game to decide
+        whether to use the solver. */
+    static unsigned get_nu_legal_moves(const Board& bd);
+
+    EndgameSolver();
+
+    /** Solve a position.
+        @param bd The position.
+        @param c The color to play.
+        @param max_nodes The maximum number of nodes to search (0 means no
+        limit).
+        @param[out] mv The best move or Move::null() if c has no legal moves.
+        @param[out] score The score of the game after perfect play from the
+        point of view of c (points of c minus points of the other color).
+        @return @c false if the search was aborted because the maximum number
+        of nodes was reached or abort() was called.
+        @pre is_supported(bd) */
+    bool solve(const Board& bd, Color c, size_t max_nodes, Move& mv,
+               ScoreType& score);
+
+    /** Abort a running or the next solve().
+        May be called from a different thread. The abort is not reset by
+        solve(), so an abort that arrives before solve() starts is not lost.
+        @see clear_abort() */
+    void abort() { m_abort = true; }
+
+    /** Reset the abort flag.
+        Must be called by the caller when it sets up a new solve(), before
+        abort() can be called for it. */
+    void clear_abort() { m_abort = false; }
+
+    /** Number of nodes searched in the last call of solve(). */
+    size_t get_nu_nodes() const { return m_nu_nodes; }
+
+private:
+    static constexpr unsigned nu_words = 4;
+
+    /** Maximum number of points on the board. */
+    static constexpr unsigned max_points = 64 * nu_words;
+
+    struct Bitboard
+    {
+        array<uint_least64_t, nu_words> words;
+
+        void clear() { words.fill(0); }
+
+        void set(unsigned i)
+        {
+            words[i / 64] |= uint_least64_t(1) << (i % 64);
+        }
+
+        bool intersects(const Bitboard& b) const;
+    };
+
+    /** Precomputed information about a move. */
+    struct MoveMasks
+    {
+        Bitboard points;
+
+        Bitboard adj_points;
+
+        Bitboard attach_points;
+
+        Piece piece;
+
+        ScoreType score_points;
+    };
+
+    struct ColorState
+    {
+        Bitboard forbidden;
+
+        /** Attach points including points that became forbidden. */
+        Bitboard attach;
+
+        PieceMap<uint_least8_t> nu_left_piece;
+
+        unsigned nu_pieces_left;
+
+        ScoreType points;
+    };
+
+    struct Entry
+    {
+        enum class Bound : uint_least8_t
+        {
+            exact,
+
+            lower,
+
+            upper
+        };
+
+        uint_least64_t hash;
+
+        /** Score gained from the position on, see search(). */
+        ScoreType value;
+
+        Move move;
+
+        Bound bound;
+    };
+
+
+    /** Number of transposition table entries. */
+#ifdef PENTOBI_LOW_RESOURCES
+    static constexpr size_t table_size = size_t(1) << 16;
+#else
+    static constexpr size_t table_size = size_t(1) << 20;
+#endif
+
+    Variant m_variant;
+
+    bool m_is_initialized = false;
+
+    ScoreType m_bonus_all_pieces;
+
+    ScoreType m_bonus_one_piece;
+
+    const libpentobi_base::BoardConst* m_bc;
+
+    vector<MoveMasks> m_move_masks;
+
+    /** Random keys for the hash of each color and move. */
+    vector<uint_least64_t> m_move_keys;
+
+    /** Pieces sorted by descending score points. */
+    vector<Piece> m_pieces;
+
+    vector<Entry> m_table;
+
+    ColorMap<ColorState> m_state;
+
+    uint_least64_t m_hash;
+
+    /** Stack of the generated moves of all plies. */
+    vector<Move> m_moves;
+
+    Color m_to_play;
+
+    /** Best move at the root. */
+    Move m_best_move;
+
+    size_t m_max_nodes;
+
+    size_t m_nu_nodes;
+
+    atomic<bool> m_abort;
+
+
+    void gen_moves(Color c);
+
+    void init_variant(const Board& bd);
+
+    /** Was abort() called or the maximum number of nodes reached? */
+    bool is_aborted() const;
+
+    void play(Color c, Move mv);
+
+    /** Negamax search.
+        @return The score gained from the current position on from the point
+        of view of c. Storing the gained score instead of the final score in
+        the transposition table makes the values independent of the move
+        sequence leading to the position (which matters for the bonus for
+        playing the one-piece last). */
+    ScoreType search(Color c, ScoreType alpha, ScoreType beta,
+                     bool is_last_pass);
+};
+
+inline bool EndgameSolver::is_aborted() const
+{
+    return m_abort.load(memory_order_relaxed)
+            || (m_max_nodes > 0 && m_nu_nodes >= m_max_nodes);
+}
+
+inline bool EndgameSolver::Bitboard::intersects(const Bitboard& b) const
+{
+    uint_least64_t result = 0;
+    for (unsigned i = 0; i < nu_words; ++i)
+        result |= words[i] & b.words[i];
+    return result != 0;
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace libpentobi_mcts
+
+#endif // LIBPENTOBI_MCTS_ENDGAME_SOLVER_H
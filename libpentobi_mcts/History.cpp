@@ -6,6 +6,9 @@
 
 #include "History.h"
 
+#include <istream>
+#include <ostream>
+#include <stdexcept>
 #include "libpentobi_base/BoardUtil.h"
 
 namespace libpentobi_mcts {
@@ -15,6 +18,28 @@ using libpentobi_base::get_current_position_as_setup;
 
 //-----------------------------------------------------------------------------
 
+namespace {
+
+template<typename T>
+T read_value(istream& in)
+{
+    T t;
+    in.read(reinterpret_cast<char*>(&t), sizeof(t));
+    if (! in)
+        throw runtime_error("invalid history format");
+    return t;
+}
+
+template<typename T>
+void write_value(ostream& out, T t)
+{
+    out.write(reinterpret_cast<const char*>(&t), sizeof(t));
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
 void History::get_as_setup(Variant& variant, Setup& setup) const
 {
     LIBBOARDGAME_ASSERT(is_valid());
@@ -68,6 +93,47 @@ bool History::is_followup(
     return true;
 }
 
+void History::read(istream& in)
+{
+    clear();
+    string id(read_value<uint_least8_t>(in), ' ');
+    in.read(id.data(), static_cast<streamsize>(id.size()));
+    Variant variant;
+    if (! in || ! parse_variant_id(id, variant))
+        throw runtime_error("invalid history format");
+    auto bd = make_unique<Board>(variant);
+    auto to_play = read_value<Color::IntType>(in);
+    auto nu_moves = read_value<uint_least32_t>(in);
+    if (to_play >= bd->get_nu_colors() || nu_moves > Board::max_moves)
+        throw runtime_error("invalid history format");
+    for (uint_least32_t i = 0; i < nu_moves; ++i)
+    {
+        auto c = read_value<Color::IntType>(in);
+        auto mv = read_value<Move::IntType>(in);
+        if (c >= bd->get_nu_colors() || mv == Move::null().to_int()
+                || mv >= bd->get_board_const().get_range()
+                || ! bd->is_legal(Color(c), Move(mv)))
+            throw runtime_error("illegal move in history");
+        bd->play(Color(c), Move(mv));
+    }
+    init(*bd, Color(to_play));
+}
+
+void History::write(ostream& out) const
+{
+    LIBBOARDGAME_ASSERT(is_valid());
+    string id = to_string_id(m_variant);
+    write_value(out, static_cast<uint_least8_t>(id.size()));
+    out.write(id.data(), static_cast<streamsize>(id.size()));
+    write_value(out, m_to_play.to_int());
+    write_value(out, static_cast<uint_least32_t>(m_moves.size()));
+    for (ColorMove mv : m_moves)
+    {
+        write_value(out, mv.color.to_int());
+        write_value(out, mv.move.to_int());
+    }
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_mcts
@@ -7,11 +7,13 @@
 #ifndef LIBPENTOBI_MCTS_HISTORY_H
 #define LIBPENTOBI_MCTS_HISTORY_H
 
+#include <iosfwd>
 #include "SearchParamConst.h"
 #include "libpentobi_base/Board.h"
 
 namespace libpentobi_mcts {
 
+using namespace std;
 using libboardgame_base::ArrayList;
 using libpentobi_base::ColorMove;
 using libpentobi_base::Move;
@@ -63,6 +65,17 @@ public:
 
     Color get_to_play() const;
 
+    Variant get_variant() const;
+
+    /** Write the state in a binary format.
+        @pre is_valid() */
+    void write(ostream& out) const;
+
+    /** Read a state written with write().
+        @throws runtime_error if the stream has an invalid format or contains
+        illegal moves. */
+    void read(istream& in);
+
 private:
     bool m_is_valid;
 
@@ -91,6 +104,12 @@ inline Color History::get_to_play() const
     return m_to_play;
 }
 
+inline Variant History::get_variant() const
+{
+    LIBBOARDGAME_ASSERT(m_is_valid);
+    return m_variant;
+}
+
 inline bool History::is_valid() const
 {
     return m_is_valid;
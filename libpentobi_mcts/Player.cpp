@@ -57,6 +57,16 @@ constexpr float counts_nexos[Player::max_supported_level] =
 constexpr float counts_callisto_2[Player::max_supported_level] =
     { 30, 87, 300, 1017, 4729, 20435, 122778, 613905, 3069529 };
 
+/** Maximum number of legal moves of both colors for using the endgame solver.
+    Positions below this number can usually be solved within
+    endgame_solver_max_nodes in Duo. */
+constexpr unsigned endgame_solver_max_moves = 50;
+
+/** Maximum number of nodes for the endgame solver.
+    The solver searches about 1.5 million nodes per second on typical
+    hardware, so this limits the time lost if the solver fails. */
+constexpr size_t endgame_solver_max_nodes = 3000000;
+
 /** Suggest how much memory to use for the trees depending on the maximum
     level used. */
 size_t get_memory(unsigned max_level)
@@ -148,18 +158,28 @@ Player::Player(Variant initial_variant, unsigned max_level,
     }
 }
 
+Player::~Player()
+{
+    stop_ponder();
+}
+
 void Player::abort()
 {
     m_search.abort();
+    m_endgame_solver.abort();
     m_was_aborted = true;
 }
 
 Move Player::genmove(const Board& bd, Color c)
 {
+    stop_ponder();
     m_resign = false;
     m_was_aborted = false;
+    m_search.clear_abort();
+    m_endgame_solver.clear_abort();
     if (! bd.has_moves(c))
         return Move::null();
+    Timer timer(m_time_source);
     Move mv;
     auto variant = bd.get_variant();
     auto board_type = bd.get_board_type();
@@ -175,7 +195,11 @@ Move Player::genmove(const Board& bd, Color c)
         {
             mv = m_book.genmove(bd, c);
             if (! mv.is_null())
+            {
+                if (m_use_clock)
+                    update_clock(bd, c, timer());
                 return mv;
+            }
         }
     }
     Float max_count = 0;
@@ -184,6 +208,8 @@ Move Player::genmove(const Board& bd, Color c)
         max_count = m_fixed_simulations;
     else if (m_fixed_time > 0)
         max_time = m_fixed_time;
+    else if (m_use_clock)
+        max_time = get_time_budget(bd, c);
     else
     {
         switch (board_type)
@@ -245,13 +271,47 @@ Move Player::genmove(const Board& bd, Color c)
             max_count = ceil(max_count * weight);
         }
     }
+    // Don't use the endgame solver in low levels, perfect play would make the
+    // endgame too strong for beginners
+    bool is_low_level = (m_fixed_simulations == 0 && m_fixed_time == 0
+                         && ! m_use_clock && level < 4);
+    if (! is_low_level && EndgameSolver::is_supported(bd)
+            && EndgameSolver::get_nu_legal_moves(bd)
+               <= endgame_solver_max_moves)
+    {
+        auto max_nodes = endgame_solver_max_nodes;
+        // Assume at least one million nodes per second
+        if (max_time > 0)
+            max_nodes = min(max_nodes, static_cast<size_t>(max_time * 1e6));
+        ScoreType score;
+        if (m_endgame_solver.solve(bd, c, max_nodes, mv, score))
+        {
+            if (m_use_clock)
+                update_clock(bd, c, timer());
+            return mv;
+        }
+        if (m_was_aborted)
+        {
+            // Return a move quickly
+            max_count = 1;
+            max_time = 0;
+        }
+        else if (max_time > 0)
+            max_time = max(max_time - timer(), 0.01);
+    }
     if (max_count != 0)
         LIBBOARDGAME_LOG("MaxCnt ", fixed, setprecision(0), max_count);
     else
         LIBBOARDGAME_LOG("MaxTime ", max_time);
     if (! m_search.search(mv, bd, c, max_count, 0, max_time, m_time_source))
         return Move::null();
-    m_was_aborted = m_search.was_aborted();
+    m_was_aborted = (m_was_aborted || m_search.was_aborted());
+    bool use_clock = (m_use_clock && m_fixed_simulations == 0
+                      && m_fixed_time == 0);
+    if (use_clock && ! m_was_aborted)
+        extend_unstable_search(mv, bd, c, max_time);
+    if (m_use_clock)
+        update_clock(bd, c, timer());
     // Resign only in two-player game variants
     if (get_nu_players(variant) == 2)
         if (m_search.get_root_visit_count() > 500
@@ -260,6 +320,63 @@ Move Player::genmove(const Board& bd, Color c)
     return mv;
 }
 
+double Player::get_time_budget(const Board& bd, Color c) const
+{
+    auto& clock = m_clock[c];
+    double budget;
+    if (clock.stones > 0)
+        budget = clock.time / clock.stones;
+    else
+    {
+        // Usually not all pieces can be played, so we expect the number of
+        // remaining moves to be lower than the number of pieces left but
+        // never assume that less than 2 moves are left
+        auto nu_pieces_left = bd.get_pieces_left(c).size();
+        auto second_color = bd.get_second_color(c);
+        if (second_color != c)
+            nu_pieces_left += bd.get_pieces_left(second_color).size();
+        auto moves_left = max(0.6 * double(nu_pieces_left), 2.);
+        budget = clock.time / moves_left;
+        if (m_byo_yomi_stones > 0)
+            budget = max(budget, m_byo_yomi_time / m_byo_yomi_stones);
+    }
+    // Keep a safety margin for the communication with the controller and the
+    // overhead of stopping the search threads
+    budget = max(0.9 * budget - 0.05, 0.01);
+    LIBBOARDGAME_LOG("Clock ", fixed, setprecision(1), clock.time, " (",
+                     clock.stones, "), Budget ", setprecision(2), budget);
+    return budget;
+}
+
+void Player::extend_unstable_search(Move& mv, const Board& bd, Color c,
+                                    double budget)
+{
+    auto& tree = m_search.get_tree();
+    auto children = tree.get_root_children();
+    if (children.empty())
+        return;
+    auto most_visited = children.begin();
+    for (auto& i : children)
+        if (i.get_visit_count() > most_visited->get_visit_count())
+            most_visited = &i;
+    if (most_visited == m_search.select_final())
+        return;
+    // Extend only in main time and only if the extension does not use more
+    // than a small part of the remaining time
+    auto& clock = m_clock[c];
+    auto extension = 0.5 * budget;
+    if (clock.stones > 0 || clock.time < budget + 8 * extension)
+        return;
+    LIBBOARDGAME_LOG("Unstable best move, extending search");
+    bool reuse_tree = m_search.get_reuse_tree();
+    m_search.set_reuse_tree(true);
+    Move extended_mv;
+    if (m_search.search(extended_mv, bd, c, 0, 0, extension, m_time_source))
+        mv = extended_mv;
+    m_search.set_reuse_tree(reuse_tree);
+    m_was_aborted = m_search.was_aborted();
+}
+
 Rating Player::get_rating(Variant variant, unsigned level)
 {
     // The ratings are roughly based on Elo differences measured in self-play
@@ -356,6 +473,80 @@ bool Player::resign() const
     return m_resign;
 }
 
+void Player::set_time_left(Color c, double time, unsigned stones)
+{
+    m_clock[c].time = time;
+    m_clock[c].stones = stones;
+}
+
+void Player::set_time_settings(double main_time, double byo_yomi_time,
+                               unsigned byo_yomi_stones)
+{
+    m_use_clock = ((main_time > 0 || byo_yomi_time > 0)
+                   && ! (byo_yomi_time > 0 && byo_yomi_stones == 0));
+    m_byo_yomi_time = byo_yomi_time;
+    m_byo_yomi_stones = byo_yomi_stones;
+    if (main_time > 0 || byo_yomi_stones == 0)
+        m_clock.fill({main_time, 0});
+    else
+        m_clock.fill({byo_yomi_time, byo_yomi_stones});
+}
+
+void Player::set_ponder(bool enable)
+{
+    if (! enable)
+        stop_ponder();
+    m_ponder = enable;
+}
+
+void Player::start_ponder(const Board& bd, Color c)
+{
+    stop_ponder();
+    if (! m_ponder || bd.is_game_over() || ! bd.has_moves(c))
+        return;
+    if (! m_ponder_bd)
+        m_ponder_bd = make_unique<Board>(bd.get_variant());
+    m_ponder_bd->copy_from(bd);
+    LIBBOARDGAME_LOG("Pondering");
+    m_search.clear_abort();
+    m_ponder_result = async(launch::async, [this, c] {
+        Move mv;
+        // Search without limit until aborted by stop_ponder()
+        m_search.search(mv, *m_ponder_bd, c, 0, 0,
+                        numeric_limits<double>::max(), m_time_source);
+    });
+}
+
+void Player::update_clock(const Board& bd, Color c, double time)
+{
+    auto& clock = m_clock[c];
+    clock.time -= time;
+    if (clock.stones > 0)
+    {
+        if (--clock.stones == 0)
+        {
+            // Next byo-yomi period
+            clock.time = m_byo_yomi_time;
+            clock.stones = m_byo_yomi_stones;
+        }
+    }
+    else if (clock.time <= 0 && m_byo_yomi_stones > 0)
+    {
+        clock.time = m_byo_yomi_time;
+        clock.stones = m_byo_yomi_stones;
+    }
+    // Both colors of a player use the same clock
+    m_clock[bd.get_second_color(c)] = clock;
+}
+
+void Player::stop_ponder()
+{
+    if (! m_ponder_result.valid())
+        return;
+    m_search.abort();
+    m_ponder_result.get();
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_mcts
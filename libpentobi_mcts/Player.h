@@ -7,8 +7,11 @@
 #ifndef LIBPENTOBI_MCTS_PLAYER_H
 #define LIBPENTOBI_MCTS_PLAYER_H
 
+#include <future>
+#include "EndgameSolver.h"
 #include "Search.h"
 #include "libboardgame_base/Rating.h"
+#include "libboardgame_base/Timer.h"
 #include "libboardgame_base/WallTimeSource.h"
 #include "libpentobi_base/Book.h"
 #include "libpentobi_base/PlayerBase.h"
@@ -16,6 +19,7 @@
 namespace libpentobi_mcts {
 
 using libboardgame_base::Rating;
+using libboardgame_base::Timer;
 using libboardgame_base::WallTimeSource;
 using libpentobi_base::Book;
 using libpentobi_base::PlayerBase;
@@ -39,10 +43,20 @@ public:
     Player(Variant initial_variant, unsigned max_level, const string& books_dir,
            unsigned nu_threads = 0);
 
+    ~Player() override;
+
     Move genmove(const Board& bd, Color c) override;
 
     bool resign() const override;
 
+    /** Start pondering if enabled with set_ponder().
+        Searches the position in a background thread until stop_ponder() is
+        called. The search tree is kept, so that the following genmove() can
+        reuse the subtree of the position after the opponent's moves. */
+    void start_ponder(const Board& bd, Color c) override;
+
+    void stop_ponder() override;
+
     Float get_fixed_simulations() const;
 
     double get_fixed_time() const;
@@ -58,10 +72,40 @@ public:
         (maximum) time per search independent of the playing level. */
     void set_fixed_time(double seconds);
 
+    /** Use a game clock with the time control of the GTP command
+        time_settings (Canadian byo-yomi).
+        If the clock is used, the time per move is computed from the
+        remaining time and the expected number of remaining moves and the
+        playing level is ignored. A fixed number of simulations or a fixed
+        time per move still take precedence.
+        @param main_time The main time in seconds.
+        @param byo_yomi_time The time in seconds for a byo-yomi period.
+        @param byo_yomi_stones The number of moves in a byo-yomi period. If
+        byo_yomi_time is greater than zero and byo_yomi_stones is zero, or if
+        main_time and byo_yomi_time are zero, no clock is used. */
+    void set_time_settings(double main_time, double byo_yomi_time,
+                           unsigned byo_yomi_stones);
+
+    /** Set the remaining time of a color as in the GTP command time_left.
+        Without calls to this function, the player keeps track of the
+        remaining time from the time used in genmove().
+        @param c
+        @param time The remaining time in the main time or in the current
+        byo-yomi period.
+        @param stones The number of moves remaining in the current byo-yomi
+        period, 0 if in main time. */
+    void set_time_left(Color c, double time, unsigned stones);
+
     bool get_use_book() const;
 
     void set_use_book(bool enable);
 
+    bool get_ponder() const { return m_ponder; }
+
+    /** Enable searching on the opponent's time.
+        See start_ponder(). Disabled by default. */
+    void set_ponder(bool enable);
+
     unsigned get_level() const;
 
     void set_level(unsigned level);
@@ -95,6 +139,17 @@ public:
     bool was_aborted() const { return m_was_aborted; }
 
 private:
+    /** Remaining time of a color. */
+    struct Clock
+    {
+        /** Remaining time in the main time or the current byo-yomi period. */
+        double time;
+
+        /** Remaining moves in the current byo-yomi period, 0 in main time. */
+        unsigned stones;
+    };
+
+
     bool m_is_book_loaded;
 
     bool m_use_book;
@@ -103,6 +158,10 @@ private:
 
     bool m_was_aborted;
 
+    bool m_ponder = false;
+
+    bool m_use_clock = false;
+
     string m_books_dir;
 
     unsigned m_max_level;
@@ -123,15 +182,41 @@ private:
 
     double m_fixed_time;
 
+    double m_byo_yomi_time = 0;
+
+    unsigned m_byo_yomi_stones = 0;
+
+    ColorMap<Clock> m_clock;
+
     Search m_search;
 
+    EndgameSolver m_endgame_solver;
+
     Book m_book;
 
     WallTimeSource m_time_source;
 
+    /** Copy of the position used for pondering. */
+    unique_ptr<Board> m_ponder_bd;
+
+    future<void> m_ponder_result;
+
+
+    /** Get the time to use for a move if the game clock is used. */
+    double get_time_budget(const Board& bd, Color c) const;
 
     void init_settings();
 
+    /** Search again if the best move of the last search is not the one with
+        the most visits.
+        Uses the tree of the last search if there is enough time left on the
+        game clock. */
+    void extend_unstable_search(Move& mv, const Board& bd, Color c,
+                                double budget);
+
+    /** Subtract the time used for a move from the game clock. */
+    void update_clock(const Board& bd, Color c, double time);
+
     bool load_book(const string& filepath);
 };
 
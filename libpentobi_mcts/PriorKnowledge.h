@@ -53,6 +53,10 @@ public:
                       bool is_symmetry_broken, Tree::NodeExpander& expander,
                       Float root_val);
 
+    /** Did the last call of gen_children() generate a child for each move?
+        This is not the case if moves were pruned. */
+    bool has_all_moves() const { return m_has_all_moves; }
+
 private:
     struct MoveFeatures
     {
@@ -121,6 +125,9 @@ private:
 
     bool m_has_connect_move;
 
+    /** See has_all_moves() */
+    bool m_has_all_moves;
+
     ColorMap<bool> m_check_dist_to_center;
 
     Variant m_variant;
@@ -340,6 +347,7 @@ bool PriorKnowledge::gen_children(const Board& bd, const MoveList& moves,
                                   bool is_symmetry_broken,
                                   Tree::NodeExpander& expander, Float root_val)
 {
+    m_has_all_moves = true;
     if (moves.empty())
     {
         // Add a pass move. The in-tree phase of the search assumes alternating
@@ -410,13 +418,19 @@ bool PriorKnowledge::gen_children(const Board& bd, const MoveList& moves,
         if ((check_dist_to_center
              && features.dist_to_center > m_min_dist_to_center)
                 || (check_connect && ! features.connect))
+        {
+            m_has_all_moves = false;
             continue;
+        }
         auto mv = moves[i];
         // If a symmetric draw is still possible, consider only moves that
         // break the symmetry
         if (has_symmetry_breaker
                 && ! bd.get_move_info_ext_2(mv).breaks_symmetry)
+        {
+            m_has_all_moves = false;
             continue;
+        }
         Float move_prior = features.gamma * inv_sum_gamma;
         // Empirical good formula for value initialization
         Float value = root_val * sqrt(features.gamma * inv_max_gamma);
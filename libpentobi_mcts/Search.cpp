@@ -93,6 +93,25 @@ bool Search::search(Move& mv, const Board& bd, Color to_play,
     return result;
 }
 
+void Search::read_tree(istream& in)
+{
+    History history;
+    history.read(in);
+    auto variant = history.get_variant();
+    // Moves of another game variant would be used for accessing the move
+    // info of the variant of the history. Whether a move is legal depends on
+    // the position of its node and is not checked.
+    auto range = BoardConst::get(variant).get_range();
+    SearchBase::read_tree(in, [range](const Move& mv) {
+        return mv.to_int() < range;
+    });
+    if (variant != m_variant)
+        set_default_param(variant);
+    m_variant = variant;
+    m_to_play = history.get_to_play();
+    m_last_history = history;
+}
+
 void Search::set_default_param(Variant variant)
 {
     LIBBOARDGAME_LOG("Setting default parameters for ", to_string(variant));
@@ -167,6 +186,12 @@ string Search::get_info() const
     return s.str();
 }
 
+void Search::write_tree(ostream& out) const
+{
+    m_last_history.write(out);
+    SearchBase::write_tree(out);
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_mcts
@@ -77,6 +77,17 @@ public:
         @param[out] setup */
     void get_root_position(Variant& variant, Setup& setup) const;
 
+    /** Write the position and tree of the last search.
+        See SearchBase::write_tree().
+        @pre get_last_history().is_valid() */
+    void write_tree(ostream& out) const;
+
+    /** Read a position and tree written with write_tree().
+        The next search in this position or a followup position continues
+        with the tree.
+        @throws runtime_error if the stream has an invalid format. */
+    void read_tree(istream& in);
+
 protected:
     void on_start_search(bool is_followup) override;
 
@@ -61,6 +61,12 @@ struct SearchParamConst
 
     static constexpr bool virtual_loss = true;
 
+    static constexpr unsigned atomic_update_depth = 1;
+
+    static constexpr bool use_transpositions = true;
+
+    static constexpr bool use_solver = true;
+
     static constexpr Float child_min_count = 3;
 
     static constexpr Float max_move_prior = 1;
@@ -73,6 +79,10 @@ struct SearchParamConst
 
     static constexpr Float expansion_threshold_inc = 0.5f;
 
+    static constexpr unsigned widening_nu_children = 64;
+
+    static constexpr Float widening_visit_ratio = 0.5f;
+
     static constexpr double expected_sim_per_sec = 100;
 };
 
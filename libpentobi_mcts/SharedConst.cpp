@@ -6,8 +6,11 @@
 
 #include "SharedConst.h"
 
+#include "libboardgame_mcts/ThreadPool.h"
+
 namespace libpentobi_mcts {
 
+using libboardgame_mcts::ThreadPool;
 using libpentobi_base::BoardConst;
 using libpentobi_base::BoardType;
 using libpentobi_base::Piece;
@@ -207,73 +210,26 @@ void SharedConst::init(bool is_followup)
     auto& bd = *board;
     auto& bc = bd.get_board_const();
 
-    // Initialize precomp_moves
+    // Initialize precomp_moves. The colors are independent of each other and
+    // are initialized in parallel if the thread pool has worker threads.
     PointList points;
     unsigned n = 0;
     for (Point p : bd)
         if (bd.get_point_state(p).is_empty() && bc.has_adj_status_points(p))
             points.get_unchecked(n++) = p;
     points.resize(n);
-    for (Color c : bd.get_colors())
+    auto& thread_pool = ThreadPool::get_global();
+    if (thread_pool.get_nu_threads() == 0)
+        for (Color c : bd.get_colors())
+            init_precomp_moves(c, points, is_followup);
+    else
     {
-        auto& precomp = precomp_moves[c];
-        auto& old_precomp = (is_followup ? precomp : bc.get_precomp_moves());
-        m_is_forbidden.set();
-
-        // Don't use bd.get_pieces_left() because its ordering is not preserved
-        // during a game. The in-place construction requires that the loop
-        // iterates in the same order as during the last construction such that
-        // it doesn't overwrite elements it still needs to read.
-        Board::PiecesLeftList pieces;
-        for (Piece::IntType i = 0; i < bc.get_nu_pieces(); ++i)
-            if (bd.is_piece_left(c, Piece(i)))
-                pieces.push_back(Piece(i));
-
-        for (Point p : points)
-            if (! bd.is_forbidden(p, c))
-            {
-                auto adj_status = bd.get_adj_status(p, c);
-                for (Piece piece : pieces)
-                {
-                    if (! old_precomp.has_moves(piece, p, adj_status))
-                        continue;
-                    for (Move mv : old_precomp.get_moves(piece, p, adj_status))
-                        if (m_is_forbidden[mv] && ! bd.is_forbidden(c, mv))
-                            m_is_forbidden.clear(mv);
-                }
-            }
-        if (! is_followup)
-            for (Point p : points)
-                if (! bd.is_forbidden(p, c))
-                {
-                    auto adj_status = bd.get_adj_status(p, c);
-                    for (unsigned i = 0; i < PrecompMoves::nu_adj_status; ++i)
-                        if (is_followup_adj_status(i, adj_status))
-                            for (auto piece : pieces)
-                                precomp.set_list_range(p, i, piece, 0, 0);
-                }
-        unsigned n = 0;
-        for (Point p : points)
-        {
-            if (bd.is_forbidden(p, c))
-                continue;
-            auto adj_status = bd.get_adj_status(p, c);
-            for (unsigned i = 0; i < PrecompMoves::nu_adj_status; ++i)
-            {
-                if (! is_followup_adj_status(i, adj_status))
-                    continue;
-                for (auto piece : pieces)
-                {
-                    if (! old_precomp.has_moves(piece, p, i))
-                        continue;
-                    auto begin = n;
-                    for (auto& mv : old_precomp.get_moves(piece, p, i))
-                        if (! m_is_forbidden[mv])
-                            precomp.set_move(n++, mv);
-                    precomp.set_list_range(p, i, piece, begin, n - begin);
-                }
-            }
-        }
+        vector<ThreadPool::Task> tasks;
+        for (Color c : bd.get_colors())
+            tasks.emplace_back([this, c, &points, is_followup] {
+                init_precomp_moves(c, points, is_followup);
+            });
+        thread_pool.run(tasks);
     }
 
     if (! is_followup)
@@ -361,6 +317,72 @@ void SharedConst::init_pieces_considered()
     is_piece_considered_none.fill(false);
 }
 
+void SharedConst::init_precomp_moves(Color c, const PointList& points,
+                                     bool is_followup)
+{
+    auto& bd = *board;
+    auto& bc = bd.get_board_const();
+    auto& precomp = precomp_moves[c];
+    auto& old_precomp = (is_followup ? precomp : bc.get_precomp_moves());
+    auto& is_forbidden = m_is_forbidden[c];
+    is_forbidden.set();
+
+    // Don't use bd.get_pieces_left() because its ordering is not preserved
+    // during a game. The in-place construction requires that the loop
+    // iterates in the same order as during the last construction such that
+    // it doesn't overwrite elements it still needs to read.
+    Board::PiecesLeftList pieces;
+    for (Piece::IntType i = 0; i < bc.get_nu_pieces(); ++i)
+        if (bd.is_piece_left(c, Piece(i)))
+            pieces.push_back(Piece(i));
+
+    for (Point p : points)
+        if (! bd.is_forbidden(p, c))
+        {
+            auto adj_status = bd.get_adj_status(p, c);
+            for (Piece piece : pieces)
+            {
+                if (! old_precomp.has_moves(piece, p, adj_status))
+                    continue;
+                for (Move mv : old_precomp.get_moves(piece, p, adj_status))
+                    if (is_forbidden[mv] && ! bd.is_forbidden(c, mv))
+                        is_forbidden.clear(mv);
+            }
+        }
+    if (! is_followup)
+        for (Point p : points)
+            if (! bd.is_forbidden(p, c))
+            {
+                auto adj_status = bd.get_adj_status(p, c);
+                for (unsigned i = 0; i < PrecompMoves::nu_adj_status; ++i)
+                    if (is_followup_adj_status(i, adj_status))
+                        for (auto piece : pieces)
+                            precomp.set_list_range(p, i, piece, 0, 0);
+            }
+    unsigned n = 0;
+    for (Point p : points)
+    {
+        if (bd.is_forbidden(p, c))
+            continue;
+        auto adj_status = bd.get_adj_status(p, c);
+        for (unsigned i = 0; i < PrecompMoves::nu_adj_status; ++i)
+        {
+            if (! is_followup_adj_status(i, adj_status))
+                continue;
+            for (auto piece : pieces)
+            {
+                if (! old_precomp.has_moves(piece, p, i))
+                    continue;
+                auto begin = n;
+                for (auto& mv : old_precomp.get_moves(piece, p, i))
+                    if (! is_forbidden[mv])
+                        precomp.set_move(n++, mv);
+                precomp.set_list_range(p, i, piece, begin, n - begin);
+            }
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 
 } // namespace libpentobi_mcts
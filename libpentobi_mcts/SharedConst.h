@@ -79,12 +79,16 @@ public:
 
 private:
     /** Temporary variable used in init().
-        Reused for efficiency. */
-    MoveMarker m_is_forbidden;
+        Reused for efficiency. One per color, such that the colors can be
+        initialized in parallel. */
+    ColorMap<MoveMarker> m_is_forbidden;
 
     void init_one_piece_callisto(bool is_followup);
 
     void init_pieces_considered();
+
+    void init_precomp_moves(Color c, const PointList& points,
+                            bool is_followup);
 };
 
 //-----------------------------------------------------------------------------
@@ -6,6 +6,7 @@
 
 #include "State.h"
 
+#include <random>
 #include "libboardgame_base/MathUtil.h"
 #include "libpentobi_base/ScoreUtil.h"
 #ifdef LIBBOARDGAME_DEBUG
@@ -33,6 +34,21 @@ inline Float sigmoid(Float steepness, Float x)
 
 //-----------------------------------------------------------------------------
 
+State::HashKeys::HashKeys()
+{
+    // Fixed seed, the keys only need to be random, not different in each run.
+    // The seed differs from the one in Board::HashKeys to avoid equal keys.
+    mt19937_64 generator(1);
+    for (auto& key : nu_passes)
+        key = generator();
+    symmetry_broken = generator();
+    force_consider_all_pieces = generator();
+}
+
+const State::HashKeys State::s_hash_keys;
+
+//-----------------------------------------------------------------------------
+
 State::State(Variant initial_variant, const SharedConst& shared_const)
   : m_shared_const(shared_const),
     m_bd(initial_variant),
@@ -104,7 +120,7 @@ void State::add_starting_moves(Color c, const Board::PiecesLeftList& pieces,
         return;
     unsigned nu_moves = 0;
     auto& marker = m_marker[c];
-    auto& is_forbidden = m_bd.is_forbidden(c);
+    auto& forbidden = m_bd.get_forbidden_bitset(c);
     float total_gamma = 0;
     bool is_gembloq = (m_bd.get_piece_set() == PieceSet::gembloq);
     for (Piece piece : pieces)
@@ -114,7 +130,7 @@ void State::add_starting_moves(Color c, const Board::PiecesLeftList& pieces,
             // (=quarter-square tringle) are legal.
             if (is_gembloq && ! m_bd.is_legal(c, mv))
                 continue;
-            if (check_forbidden<MAX_SIZE>(is_forbidden, mv, moves, nu_moves))
+            if (check_forbidden(forbidden, mv, moves, nu_moves))
             {
                 LIBBOARDGAME_ASSERT(! marker[mv]);
                 marker.set(mv);
@@ -128,20 +144,10 @@ void State::add_starting_moves(Color c, const Board::PiecesLeftList& pieces,
     moves.resize(nu_moves);
 }
 
-template<unsigned MAX_SIZE>
-bool State::check_forbidden(const GridExt<bool>& is_forbidden, Move mv,
+bool State::check_forbidden(const PointBitset& forbidden, Move mv,
                             MoveList& moves, unsigned& nu_moves)
 {
-    auto p = get_move_info<MAX_SIZE>(mv).begin();
-    unsigned forbidden = is_forbidden[*p];
-    for (unsigned i = 1; i < MAX_SIZE; ++i)
-        // Logically, forbidden is a bool and the next line should be
-        //   forbidden = forbidden || is_forbidden[*(++p)]
-        // But this generates branches, which are bad for performance in this
-        // tight loop (unrolled by the compiler). So we use a bitwise OR, which
-        // works because C++ guarantees that true/false converts to 1/0.
-        forbidden |= static_cast<unsigned>(is_forbidden[*(++p)]);
-    if (forbidden != 0)
+    if (forbidden.intersects(m_bd.get_board_const().get_move_mask(mv)))
         return false;
     LIBBOARDGAME_ASSERT(nu_moves < MoveList::max_size);
     moves.get_unchecked(nu_moves) = mv;
@@ -378,43 +384,43 @@ bool State::gen_children(Tree::NodeExpander& expander, Float root_val)
                 root_val);
 }
 
+template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
+inline bool State::gen_playout_move(const LastGoodReply& lgr, Move last,
+                                    Move second_last, PlayerMove& mv)
+{
+    if (m_nu_passes == m_nu_colors)
+        return false;
+    if (! m_is_symmetry_broken
+            && m_bd.get_nu_onboard_pieces() >= m_symmetry_min_nu_pieces)
+        // See also the comment in evaluate_playout()
+        return false;
+    PlayerInt player = get_player();
+    Move lgr2 = lgr.get_lgr2(player, last, second_last);
+    if (check_lgr<IS_CALLISTO>(lgr2))
+    {
+        mv = {player, lgr2};
+        return true;
+    }
+    Move lgr1 = lgr.get_lgr1(player, last);
+    if (check_lgr<IS_CALLISTO>(lgr1))
+    {
+        mv = {player, lgr1};
+        return true;
+    }
+    return gen_playout_move_full<MAX_SIZE, MAX_ADJ_ATTACH, IS_CALLISTO>(mv);
+}
+
+template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
 bool State::gen_playout_move_full(PlayerMove& mv)
 {
     Color to_play = m_bd.get_to_play();
     while (true)
     {
         if (! m_is_move_list_initialized[to_play])
-        {
-            if (m_max_piece_size == 5)
-            {
-                if (m_is_callisto)
-                    init_moves_with_gamma<5, 16, true>(to_play);
-                else
-                    init_moves_with_gamma<5, 16, false>(to_play);
-            }
-            else if (m_max_piece_size == 6)
-                init_moves_with_gamma<6, 22, false>(to_play);
-            else if (m_max_piece_size == 7)
-                init_moves_with_gamma<7, 12, false>(to_play);
-            else
-                init_moves_with_gamma<22, 44, false>(to_play);
-        }
+            init_moves_with_gamma<MAX_SIZE, MAX_ADJ_ATTACH, IS_CALLISTO>(
+                        to_play);
         else if (m_has_moves[to_play])
-        {
-            if (m_max_piece_size == 5)
-            {
-                if (m_is_callisto)
-                    update_moves<5, 16, true>(to_play);
-                else
-                    update_moves<5, 16, false>(to_play);
-            }
-            else if (m_max_piece_size == 6)
-                update_moves<6, 22, false>(to_play);
-            else if (m_max_piece_size == 7)
-                update_moves<7, 12, false>(to_play);
-            else
-                update_moves<22, 44, false>(to_play);
-        }
+            update_moves<MAX_SIZE, MAX_ADJ_ATTACH, IS_CALLISTO>(to_play);
         if ((m_has_moves[to_play] = ! m_moves[to_play].empty()))
             break;
         if (++m_nu_passes == m_nu_colors)
@@ -719,7 +725,7 @@ void State::init_moves_without_gamma(Color c)
     auto& moves = m_moves[c];
     marker.clear(moves);
     auto& pieces = get_pieces_considered<IS_CALLISTO>(c);
-    auto& is_forbidden = m_bd.is_forbidden(c);
+    auto& forbidden = m_bd.get_forbidden_bitset(c);
     if (m_bd.is_first_piece(c) && ! IS_CALLISTO)
         add_starting_moves<MAX_SIZE>(c, pieces, false, moves);
     else
@@ -735,7 +741,7 @@ void State::init_moves_without_gamma(Color c)
                 != &m_shared_const.is_piece_considered_none)
             for (Point p : m_bd.get_attach_points(c))
             {
-                if (is_forbidden[p])
+                if (forbidden[p])
                     continue;
                 auto adj_status = m_bd.get_adj_status(p, c);
                 for (Piece piece : pieces)
@@ -744,8 +750,8 @@ void State::init_moves_without_gamma(Color c)
                         continue;
                     for (Move mv : get_moves(c, piece, p, adj_status))
                         if (! marker[mv]
-                                && check_forbidden<MAX_SIZE>(
-                                    is_forbidden, mv, moves, nu_moves))
+                                && check_forbidden(forbidden, mv, moves,
+                                                   nu_moves))
                             marker.set(mv);
                 }
                 m_moves_added_at[c][p] = true;
@@ -767,7 +773,16 @@ void State::init_moves_without_gamma(Color c)
 void State::play_expanded_child(Move mv)
 {
     if (! mv.is_null())
-        play_playout(mv);
+    {
+        if (m_max_piece_size == 5)
+            play_playout<5, 16>(mv);
+        else if (m_max_piece_size == 6)
+            play_playout<6, 22>(mv);
+        else if (m_max_piece_size == 7)
+            play_playout<7, 12>(mv);
+        else
+            play_playout<22, 44>(mv);
+    }
     else
     {
         ++m_nu_passes;
@@ -780,6 +795,57 @@ void State::play_expanded_child(Move mv)
     }
 }
 
+template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
+inline void State::play_playout(Move mv)
+{
+    auto to_play = m_bd.get_to_play();
+    LIBBOARDGAME_ASSERT(m_bd.is_legal(to_play, mv));
+    m_bd.play<MAX_SIZE, MAX_ADJ_ATTACH>(to_play, mv);
+    update_playout_features<MAX_SIZE, MAX_ADJ_ATTACH>(to_play, mv);
+    if (MAX_SIZE == 7)
+        // No game variant with piece size 7 uses m_is_symmetry_broken
+        LIBBOARDGAME_ASSERT(m_is_symmetry_broken);
+    else if (! m_is_symmetry_broken)
+        update_symmetry_broken<MAX_SIZE>(mv);
+    ++m_nu_new_moves[to_play];
+    m_last_move[to_play] = mv;
+    m_nu_passes = 0;
+}
+
+void State::playout(const LastGoodReply& lgr, PlayerMoveList& moves)
+{
+    if (m_max_piece_size == 5)
+    {
+        if (m_is_callisto)
+            playout<5, 16, true>(lgr, moves);
+        else
+            playout<5, 16, false>(lgr, moves);
+    }
+    else if (m_max_piece_size == 6)
+        playout<6, 22, false>(lgr, moves);
+    else if (m_max_piece_size == 7)
+        playout<7, 12, false>(lgr, moves);
+    else
+        playout<22, 44, false>(lgr, moves);
+}
+
+template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
+void State::playout(const LastGoodReply& lgr, PlayerMoveList& moves)
+{
+    auto nu_moves = moves.size();
+    Move last = nu_moves > 0 ? moves[nu_moves - 1].move : Move::null();
+    Move second_last = nu_moves > 1 ? moves[nu_moves - 2].move : Move::null();
+    PlayerMove mv;
+    while (gen_playout_move<MAX_SIZE, MAX_ADJ_ATTACH, IS_CALLISTO>(
+               lgr, last, second_last, mv))
+    {
+        play_playout<MAX_SIZE, MAX_ADJ_ATTACH>(mv.move);
+        moves.push_back(mv);
+        second_last = last;
+        last = mv.move;
+    }
+}
+
 void State::start_search()
 {
     auto& bd = *m_shared_const.board;
@@ -829,7 +895,12 @@ void State::start_search()
 
 void State::start_simulation([[maybe_unused]] size_t n)
 {
-    m_bd.restore_snapshot();
+    // Undo the moves of the last simulation instead of restoring the
+    // snapshot, which is faster because a simulation changes only a small
+    // part of the board state.
+    while (m_bd.can_undo())
+        m_bd.undo();
+    m_bd.set_to_play(m_shared_const.to_play);
     m_force_consider_all_pieces = false;
     auto& geo = m_bd.get_geometry();
     for (Color c : Color::Range(m_nu_colors))
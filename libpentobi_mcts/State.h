@@ -13,14 +13,18 @@
 #include "StateUtil.h"
 #include "libboardgame_mcts/LastGoodReply.h"
 #include "libboardgame_mcts/PlayerMove.h"
+#include "libboardgame_base/ArrayList.h"
 #include "libboardgame_base/RandomGenerator.h"
 #include "libboardgame_base/Statistics.h"
 
 namespace libpentobi_mcts {
 
+using libboardgame_base::ArrayList;
 using libboardgame_base::RandomGenerator;
 using libboardgame_base::Statistics;
+using libboardgame_mcts::ProvenResult;
 using libpentobi_base::PieceSet;
+using libpentobi_base::PointBitset;
 
 //-----------------------------------------------------------------------------
 
@@ -48,6 +52,8 @@ public:
 
     using PlayerMove = libboardgame_mcts::PlayerMove<Move>;
 
+    using PlayerMoveList = ArrayList<PlayerMove, SearchParamConst::max_moves>;
+
 
     /** Constructor.
         @param initial_variant Game variant to initialize the internal
@@ -72,24 +78,43 @@ public:
     /** Get current player to play. */
     PlayerInt get_player() const;
 
+    /** Get a hash of the current position in the in-tree phase.
+        Includes all information that the generation of children depends on.
+        Extends Board::get_hash() by the number of passes, the symmetry
+        state and whether all pieces are considered because of an earlier
+        position in the simulation without moves (see
+        m_force_consider_all_pieces). */
+    uint_least64_t get_hash() const;
+
     void start_search();
 
     void start_simulation(size_t n);
 
     bool gen_children(Tree::NodeExpander& expander, Float root_val);
 
-    void start_playout() { }
-
-    /** Generate a playout move.
-        @return @c false if end of game was reached, and no move was
-        generated. */
-    bool gen_playout_move(const LastGoodReply& lgr, Move last,
-                          Move second_last, PlayerMove& mv);
+    /** Did the last call of gen_children() generate all legal moves?
+        This is not the case if not all pieces were considered or if the
+        prior knowledge pruned moves. Always false in Callisto because the
+        moves of the one-piece are restricted. */
+    bool has_all_moves() const;
+
+    /** Get the exact result of a terminal position in the in-tree phase.
+        @param player The player.
+        @return The result or ProvenResult::none if the game variant has not
+        exactly two players and two colors. */
+    ProvenResult get_proven_result(PlayerInt player) const;
+
+    /** Play the playout phase of a simulation.
+        Generates and plays moves until the end of the game and appends them
+        to the moves of the simulation. The code specialized for the
+        geometry of the game variant is selected once per playout, not once
+        per move.
+        @param lgr The Last-Good-Reply heuristic.
+        @param moves The moves of the simulation played so far. */
+    void playout(const LastGoodReply& lgr, PlayerMoveList& moves);
 
     void evaluate_playout(array<Float, 6>& result);
 
-    void play_playout(Move mv);
-
     /** Check if RAVE value for this move should not be updated. */
     static bool skip_rave([[maybe_unused]] Move mv) { return false; }
 
@@ -100,6 +125,21 @@ public:
     string get_info() const;
 
 private:
+    /** Random keys for get_hash() in addition to Board::get_hash(). */
+    struct HashKeys
+    {
+        array<uint_least64_t, Color::range + 1> nu_passes;
+
+        uint_least64_t symmetry_broken;
+
+        uint_least64_t force_consider_all_pieces;
+
+        HashKeys();
+    };
+
+
+    static const HashKeys s_hash_keys;
+
     /** The cumulative gamma value of the moves in m_moves. */
     array<float, MoveList::max_size> m_cumulative_gamma;
 
@@ -253,10 +293,10 @@ private:
     template<unsigned MAX_SIZE, bool IS_CALLISTO>
     void init_moves_without_gamma(Color c);
 
-    template<unsigned MAX_SIZE>
-    bool check_forbidden(const GridExt<bool>& is_forbidden, Move mv,
+    bool check_forbidden(const PointBitset& forbidden, Move mv,
                          MoveList& moves, unsigned& nu_moves);
 
+    template<bool IS_CALLISTO>
     bool check_lgr(Move mv) const;
 
     template<unsigned MAX_SIZE>
@@ -271,7 +311,18 @@ private:
                     const PlayoutFeatures& playout_features,
                     float& total_gamma);
 
-    bool gen_playout_move_full(PlayerMove& mv);
+    template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
+    bool gen_playout_move(const LastGoodReply& lgr, Move last,
+                          Move second_last, PlayerMove& mv);
+
+    template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
+    LIBBOARDGAME_NOINLINE bool gen_playout_move_full(PlayerMove& mv);
+
+    template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
+    void play_playout(Move mv);
+
+    template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
+    void playout(const LastGoodReply& lgr, PlayerMoveList& moves);
 
     template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH, bool IS_CALLISTO>
     void update_moves(Color c);
@@ -287,6 +338,7 @@ private:
     To be faster, it doesn't check for starting moves because such moves rarely
     occur in the playout phase and doesn't check if a 1-piece move is in the
     center in Callisto because such moves are not generated in the search. */
+template<bool IS_CALLISTO>
 inline bool State::check_lgr(Move mv) const
 {
     if (mv.is_null())
@@ -295,18 +347,10 @@ inline bool State::check_lgr(Move mv) const
     auto piece = m_bd.get_move_piece(mv);
     if (! m_bd.is_piece_left(c, piece))
         return false;
-    auto points = m_bd.get_move_points(mv);
-    auto i = points.begin();
-    auto end = points.end();
-    int has_attach_point = 0;
-    do
-    {
-        if (m_bd.is_forbidden(*i, c))
-            return false;
-        has_attach_point |= static_cast<int>(m_bd.is_attach_point(*i, c));
-    }
-    while (++i != end);
-    if (m_is_callisto)
+    auto& mask = m_bd.get_board_const().get_move_mask(mv);
+    if (m_bd.get_forbidden_bitset(c).intersects(mask))
+        return false;
+    if (IS_CALLISTO)
     {
         Piece one_piece = m_bd.get_one_piece();
         if (piece == one_piece)
@@ -314,7 +358,7 @@ inline bool State::check_lgr(Move mv) const
         if (m_bd.get_nu_left_piece(c, one_piece) > 1 && piece != one_piece)
             return false;
     }
-    return has_attach_point != 0;
+    return m_bd.get_attach_point_bitset(c).intersects(mask);
 }
 
 inline void State::evaluate_playout(array<Float, 6>& result)
@@ -337,31 +381,6 @@ inline void State::finish_in_tree()
         m_is_symmetry_broken = check_symmetry_broken(m_bd);
 }
 
-inline bool State::gen_playout_move(const LastGoodReply& lgr, Move last,
-                                    Move second_last, PlayerMove& mv)
-{
-    if (m_nu_passes == m_nu_colors)
-        return false;
-    if (! m_is_symmetry_broken
-            && m_bd.get_nu_onboard_pieces() >= m_symmetry_min_nu_pieces)
-        // See also the comment in evaluate_playout()
-        return false;
-    PlayerInt player = get_player();
-    Move lgr2 = lgr.get_lgr2(player, last, second_last);
-    if (check_lgr(lgr2))
-    {
-        mv = {player, lgr2};
-        return true;
-    }
-    Move lgr1 = lgr.get_lgr1(player, last);
-    if (check_lgr(lgr1))
-    {
-        mv = {player, lgr1};
-        return true;
-    }
-    return gen_playout_move_full(mv);
-}
-
 template<unsigned MAX_SIZE>
 inline const MoveInfo<MAX_SIZE>& State::get_move_info(Move mv) const
 {
@@ -384,6 +403,32 @@ inline PrecompMoves::Range State::get_moves(Color c, Piece piece, Point p,
     return m_shared_const.precomp_moves[c].get_moves(piece, p, adj_status);
 }
 
+inline uint_least64_t State::get_hash() const
+{
+    auto hash = m_bd.get_hash() ^ s_hash_keys.nu_passes[m_nu_passes];
+    if (m_is_symmetry_broken)
+        hash ^= s_hash_keys.symmetry_broken;
+    if (m_force_consider_all_pieces)
+        hash ^= s_hash_keys.force_consider_all_pieces;
+    return hash;
+}
+
+inline ProvenResult State::get_proven_result(PlayerInt player) const
+{
+    LIBBOARDGAME_ASSERT(m_nu_passes == m_nu_colors);
+    if (m_bd.get_nu_players() != 2 || m_nu_colors != 2)
+        return ProvenResult::none;
+    auto s = m_bd.get_score_twocolor(Color(player));
+    if (s > 0)
+        return ProvenResult::win;
+    if (s < 0)
+        return ProvenResult::loss;
+    if (m_is_callisto)
+        // Tie is a loss for the first color in Callisto
+        return player == 0 ? ProvenResult::loss : ProvenResult::win;
+    return ProvenResult::draw;
+}
+
 inline PlayerInt State::get_player() const
 {
     unsigned player = m_bd.get_to_play().to_int();
@@ -392,6 +437,14 @@ inline PlayerInt State::get_player() const
     return static_cast<PlayerInt>(player);
 }
 
+inline bool State::has_all_moves() const
+{
+    return ! m_is_callisto
+            && m_is_piece_considered[m_bd.get_to_play()]
+               == &m_shared_const.is_piece_considered_all
+            && m_prior_knowledge.has_all_moves();
+}
+
 inline bool State::has_moves(Color c, Piece piece, Point p,
                              unsigned adj_status) const
 {
@@ -425,6 +478,10 @@ inline void State::play_in_tree(Move mv)
             m_bd.play<22, 44>(to_play, mv);
             update_playout_features<22, 44>(to_play, mv);
         }
+        // Needed by update_moves() if the move list was initialized by
+        // widening a node in the in-tree phase
+        ++m_nu_new_moves[to_play];
+        m_last_move[to_play] = mv;
     }
     else
     {
@@ -433,43 +490,6 @@ inline void State::play_in_tree(Move mv)
     }
 }
 
-inline void State::play_playout(Move mv)
-{
-    auto to_play = m_bd.get_to_play();
-    LIBBOARDGAME_ASSERT(m_bd.is_legal(to_play, mv));
-    if (m_max_piece_size == 5)
-    {
-        m_bd.play<5, 16>(to_play, mv);
-        update_playout_features<5, 16>(to_play, mv);
-        if (! m_is_symmetry_broken)
-            update_symmetry_broken<5>(mv);
-    }
-    else if (m_max_piece_size == 6)
-    {
-        m_bd.play<6, 22>(to_play, mv);
-        update_playout_features<6, 22>(to_play, mv);
-        if (! m_is_symmetry_broken)
-            update_symmetry_broken<6>(mv);
-    }
-    else if (m_max_piece_size == 7)
-    {
-        m_bd.play<7, 12>(to_play, mv);
-        update_playout_features<7, 12>(to_play, mv);
-        // No game variant with piece size 7 uses m_is_symmetry_broken
-        LIBBOARDGAME_ASSERT(m_is_symmetry_broken);
-    }
-    else
-    {
-        m_bd.play<22, 44>(to_play, mv);
-        update_playout_features<22, 44>(to_play, mv);
-        if (! m_is_symmetry_broken)
-            update_symmetry_broken<22>(mv);
-    }
-    ++m_nu_new_moves[to_play];
-    m_last_move[to_play] = mv;
-    m_nu_passes = 0;
-}
-
 template<unsigned MAX_SIZE, unsigned MAX_ADJ_ATTACH>
 inline void State::update_playout_features(Color c, Move mv)
 {
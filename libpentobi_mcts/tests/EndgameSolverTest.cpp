@@ -0,0 +1,139 @@
+//-----------------------------------------------------------------------------
+/** @file libpentobi_mcts/tests/EndgameSolverTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libpentobi_mcts/EndgameSolver.h"
+
+#include "libboardgame_base/SgfUtil.h"
+#include "libboardgame_base/TreeReader.h"
+#include "libboardgame_test/Test.h"
+#include "libpentobi_base/BoardUpdater.h"
+#include "libpentobi_base/MoveMarker.h"
+#include "libpentobi_base/PentobiTree.h"
+
+using namespace std;
+using namespace libpentobi_mcts;
+using libboardgame_base::SgfNode;
+using libboardgame_base::TreeReader;
+using libboardgame_base::get_last_node;
+using libpentobi_base::BoardUpdater;
+using libpentobi_base::MoveList;
+using libpentobi_base::MoveMarker;
+using libpentobi_base::PentobiTree;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+unique_ptr<Board> read_board(const char* sgf)
+{
+    istringstream in(sgf);
+    TreeReader reader;
+    reader.read(in);
+    unique_ptr<SgfNode> root = reader.get_tree_transfer_ownership();
+    PentobiTree tree(root);
+    auto bd = make_unique<Board>(tree.get_variant());
+    BoardUpdater updater;
+    updater.update(*bd, tree, get_last_node(tree.get_root()));
+    return bd;
+}
+
+/** Minimax search without pruning using Board. */
+ScoreType get_minimax_score(const Board& bd, Color c, bool is_last_pass)
+{
+    Color opp = bd.get_next(c);
+    MoveMarker marker;
+    MoveList moves;
+    bd.gen_moves(c, marker, moves);
+    if (moves.empty())
+    {
+        if (is_last_pass)
+            return bd.get_score_twocolor(c);
+        return -get_minimax_score(bd, opp, true);
+    }
+    auto best = -numeric_limits<ScoreType>::max();
+    auto bd_child = make_unique<Board>(bd.get_variant());
+    for (Move mv : moves)
+    {
+        bd_child->copy_from(bd);
+        bd_child->play(c, mv);
+        best = max(best, -get_minimax_score(*bd_child, opp, false));
+    }
+    return best;
+}
+
+// Duo position with few moves left
+const char* duo_end = R"delim(
+    (;GM[Blokus Duo];B[d9,c10,d10,e10,d11];W[j5,i6,j6,k6,j7]
+    ;B[h7,g8,h8,f9,g9];W[g5,h5,f6,g6,g7];B[d6,d7,e7,f7,e8]
+    ;W[f3,e4,f4,d5,e5];B[k8,l8,i9,j9,k9];W[c6,c7,b8,c8,c9]
+    ;B[c3,b4,c4,b5,c5];W[a3,a4,a5,a6,a7];B[e1,d2,e2,f2,g2]
+    ;W[a1,b1,c1,b2,c2];B[a9,b9,a10,a11,b11];W[h1,h2,h3,i3,i4]
+    ;B[k5,l5,m5,m6,m7];W[k3,k4,l4,m4,n4];B[j1,k1,j2,j3,j4]
+    ;W[l1,n1,l2,m2,n2];B[h10,f11,g11,h11,h12];W[l7]
+    ;B[l10,j11,k11,l11,j12];W[m8,n8,l9,m9];B[n10,n11,m12,n12]
+    ;W[i10,j10,k10,i11,i12];B[k13,l13,j14,k14];W[f13,g13,h13,g14])
+    )delim";
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+/** Compare the score of the solver with a minimax search using Board. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_endgame_solver_minimax)
+{
+    auto bd = read_board(duo_end);
+    LIBBOARDGAME_CHECK(EndgameSolver::is_supported(*bd));
+    EndgameSolver solver;
+    for (Color c : bd->get_colors())
+    {
+        Move mv;
+        ScoreType score;
+        LIBBOARDGAME_CHECK(solver.solve(*bd, c, 0, mv, score));
+        LIBBOARDGAME_CHECK_EQUAL(score, get_minimax_score(*bd, c, false));
+        LIBBOARDGAME_CHECK(bd->is_legal(c, mv));
+        // The move must achieve the score
+        auto bd_child = make_unique<Board>(bd->get_variant());
+        bd_child->copy_from(*bd);
+        bd_child->play(c, mv);
+        LIBBOARDGAME_CHECK_EQUAL(
+                    score, -get_minimax_score(*bd_child, bd->get_next(c),
+                                              false));
+    }
+}
+
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_endgame_solver_max_nodes)
+{
+    auto bd = read_board(duo_end);
+    EndgameSolver solver;
+    Move mv;
+    ScoreType score;
+    LIBBOARDGAME_CHECK(! solver.solve(*bd, Color(0), 2, mv, score));
+    // The node limit does not affect the next call
+    LIBBOARDGAME_CHECK(solver.solve(*bd, Color(0), 0, mv, score));
+}
+
+/** Test that an abort before solve() is not lost. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_endgame_solver_abort)
+{
+    auto bd = read_board(duo_end);
+    EndgameSolver solver;
+    Move mv;
+    ScoreType score;
+    solver.abort();
+    LIBBOARDGAME_CHECK(! solver.solve(*bd, Color(0), 0, mv, score));
+    solver.clear_abort();
+    LIBBOARDGAME_CHECK(solver.solve(*bd, Color(0), 0, mv, score));
+}
+
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_endgame_solver_not_supported)
+{
+    Board bd(Variant::duo);
+    LIBBOARDGAME_CHECK(! EndgameSolver::is_supported(bd));
+    bd.init(Variant::classic);
+    LIBBOARDGAME_CHECK(! EndgameSolver::is_supported(bd));
+}
+
+//-----------------------------------------------------------------------------
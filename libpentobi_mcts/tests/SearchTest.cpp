@@ -6,6 +6,7 @@
 
 #include "libpentobi_mcts/Search.h"
 
+#include <unordered_set>
 #include "libboardgame_base/SgfUtil.h"
 #include "libboardgame_base/TreeReader.h"
 #include "libboardgame_test/Test.h"
@@ -24,6 +25,42 @@ using libpentobi_base::PentobiTree;
 
 //-----------------------------------------------------------------------------
 
+namespace {
+
+/** Check that no node has two children with the same move.
+    @return The number of nodes other than the root with more children than
+    created at a node expansion. */
+unsigned check_children(const Search::Tree& tree, const Search::Node& node)
+{
+    unsigned nu_widened = 0;
+    unordered_set<Move::IntType> moves;
+    for (auto& i : tree.get_children(node))
+    {
+        LIBBOARDGAME_CHECK(moves.insert(i.get_move().to_int()).second);
+        if (i.get_nu_children() > 0)
+        {
+            if (static_cast<unsigned>(i.get_nu_children())
+                    > SearchParamConst::widening_nu_children)
+                ++nu_widened;
+            nu_widened += check_children(tree, i);
+        }
+    }
+    return nu_widened;
+}
+
+/** Get the largest integer value of the moves in a subtree. */
+Move::IntType get_max_move(const Search::Tree& tree, const Search::Node& node)
+{
+    Move::IntType result = 0;
+    for (auto& i : tree.get_children(node))
+        result = max({result, i.get_move().to_int(), get_max_move(tree, i)});
+    return result;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
 /** Test that state generates a playout move even if no large pieces are
     playable early in the game.
     This tests for a bug that occurred in Pentobi 1.1 with game variant Trigon:
@@ -106,4 +143,165 @@ LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_callisto_useless_one_piece)
     LIBBOARDGAME_CHECK(bd->get_move_piece(mv) == bd->get_one_piece());
 }
 
+/** Test a search with transpositions including reusing the subtree.
+    Reusing the subtree copies the tree and needs to handle nodes that share
+    their children. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_transpositions)
+{
+    auto bd = make_unique<Board>(Variant::classic);
+    unsigned nu_threads = 1;
+    size_t memory = 10000000;
+    auto search = make_unique<Search>(bd->get_variant(), nu_threads, memory);
+    search->set_use_transpositions(true);
+    Float max_count = 500;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    for (unsigned i = 0; i < 6; ++i)
+    {
+        Move mv;
+        auto to_play = bd->get_to_play();
+        bool res = search->search(mv, *bd, to_play, max_count,
+                                  min_simulations, max_time, time_source);
+        LIBBOARDGAME_CHECK(res);
+        LIBBOARDGAME_CHECK(bd->is_legal(to_play, mv));
+        bd->play(to_play, mv);
+    }
+}
+
+/** Test a multi-threaded search with progressive widening including reusing
+    the subtree. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_widening_multithread)
+{
+    auto bd = make_unique<Board>(Variant::trigon_2);
+    unsigned nu_threads = 4;
+    size_t memory = 100000000;
+    auto search = make_unique<Search>(bd->get_variant(), nu_threads, memory);
+    search->set_use_transpositions(true);
+    Float max_count = 1000;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    unsigned nu_widened = 0;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        Move mv;
+        auto to_play = bd->get_to_play();
+        bool res = search->search(mv, *bd, to_play, max_count,
+                                  min_simulations, max_time, time_source);
+        LIBBOARDGAME_CHECK(res);
+        LIBBOARDGAME_CHECK(bd->is_legal(to_play, mv));
+        auto& tree = search->get_tree();
+        LIBBOARDGAME_CHECK(! tree.get_root().is_partially_expanded());
+        nu_widened += check_children(tree, tree.get_root());
+        bd->play(to_play, mv);
+    }
+    LIBBOARDGAME_CHECK(nu_widened > 0);
+}
+
+/** Test that read_tree() rejects a tree with moves that are not in the
+    range of moves of the game variant of the position. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_read_tree_invalid_move)
+{
+    auto bd = make_unique<Board>(Variant::trigon_2);
+    auto search = make_unique<Search>(bd->get_variant(), 1, 10000000);
+    Move mv;
+    Float max_count = 100;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    LIBBOARDGAME_CHECK(search->search(mv, *bd, Color(0), max_count,
+                                      min_simulations, max_time,
+                                      time_source));
+    ostringstream out;
+    search->write_tree(out);
+    {
+        istringstream in(out.str());
+        LIBBOARDGAME_CHECK_NO_THROW(search->read_tree(in));
+    }
+    // Replace the position at the beginning by a Duo position, which has
+    // fewer moves than Trigon
+    auto duo_bd = make_unique<Board>(Variant::duo);
+    auto& tree = search->get_tree();
+    LIBBOARDGAME_CHECK(get_max_move(tree, tree.get_root())
+                       >= duo_bd->get_board_const().get_range());
+    History history;
+    history.init(*bd, Color(0));
+    ostringstream history_out;
+    history.write(history_out);
+    History duo_history;
+    duo_history.init(*duo_bd, Color(0));
+    ostringstream duo_out;
+    duo_history.write(duo_out);
+    istringstream in(duo_out.str()
+                     + out.str().substr(history_out.str().size()));
+    LIBBOARDGAME_CHECK_THROW(search->read_tree(in), runtime_error);
+}
+
+/** Test that the search terminates early in a proven endgame position and
+    plays a winning move. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_solver)
+{
+    istringstream
+        in(R"delim(
+           (;GM[Blokus Duo];B[d9,c10,d10,e10,d11];W[j5,i6,j6,k6,j7]
+           ;B[h7,g8,h8,f9,g9];W[g5,h5,f6,g6,g7];B[d6,d7,e7,f7,e8]
+           ;W[f3,e4,f4,d5,e5];B[k8,l8,i9,j9,k9];W[c6,c7,b8,c8,c9]
+           ;B[c3,b4,c4,b5,c5];W[a3,a4,a5,a6,a7];B[e1,d2,e2,f2,g2]
+           ;W[a1,b1,c1,b2,c2];B[a9,b9,a10,a11,b11];W[h1,h2,h3,i3,i4]
+           ;B[k5,l5,m5,m6,m7];W[k3,k4,l4,m4,n4];B[j1,k1,j2,j3,j4]
+           ;W[l1,n1,l2,m2,n2];B[h10,f11,g11,h11,h12];W[l7]
+           ;B[l10,j11,k11,l11,j12];W[m8,n8,l9,m9];B[n10,n11,m12,n12]
+           ;W[i10,j10,k10,i11,i12];B[k13,l13,j14,k14];W[f13,g13,h13,g14])
+           )delim");
+    TreeReader reader;
+    reader.read(in);
+    unique_ptr<SgfNode> root = reader.get_tree_transfer_ownership();
+    PentobiTree tree(root);
+    auto bd = make_unique<Board>(tree.get_variant());
+    BoardUpdater updater;
+    updater.update(*bd, tree, get_last_node(tree.get_root()));
+    unsigned nu_threads = 1;
+    size_t memory = 10000000;
+    auto search = make_unique<Search>(bd->get_variant(), nu_threads, memory);
+    Float max_count = 100000;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    Move mv;
+    bool res = search->search(mv, *bd, Color(0), max_count, min_simulations,
+                              max_time, time_source);
+    LIBBOARDGAME_CHECK(res);
+    LIBBOARDGAME_CHECK(search->get_root_visit_count() < max_count);
+    auto& root_node = search->get_tree().get_root();
+    LIBBOARDGAME_CHECK(root_node.get_proven() == ProvenResult::win);
+    auto child = search->select_final();
+    LIBBOARDGAME_CHECK(child->get_move() == mv);
+    LIBBOARDGAME_CHECK(child->get_proven() == ProvenResult::win);
+}
+
+/** Test that an abort before search() is not lost. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_search_abort)
+{
+    auto bd = make_unique<Board>(Variant::classic_2);
+    auto search = make_unique<Search>(bd->get_variant(), 1, 10000000);
+    Move mv;
+    Float max_count = 100000;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    search->abort();
+    LIBBOARDGAME_CHECK(search->search(mv, *bd, Color(0), max_count,
+                                      min_simulations, max_time,
+                                      time_source));
+    LIBBOARDGAME_CHECK(search->was_aborted());
+    LIBBOARDGAME_CHECK(search->get_root_visit_count() < max_count);
+    search->clear_abort();
+    max_count = 100;
+    LIBBOARDGAME_CHECK(search->search(mv, *bd, Color(0), max_count,
+                                      min_simulations, max_time,
+                                      time_source));
+    LIBBOARDGAME_CHECK(! search->was_aborted());
+}
+
 //-----------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+/** @file libpentobi_mcts/tests/StateTest.cpp
+    @author Markus Enzenberger
+    @copyright GNU General Public License version 3 or later */
+//-----------------------------------------------------------------------------
+
+#include "libpentobi_mcts/Search.h"
+
+#include "libboardgame_base/CpuTimeSource.h"
+#include "libboardgame_test/Test.h"
+
+using namespace std;
+using namespace libpentobi_mcts;
+using libboardgame_base::CpuTimeSource;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/** Finish the in-tree phase and generate the children.
+    @return The moves and move priors of the children in the order in which
+    they were generated. */
+vector<pair<Move, Float>> gen_children(State& state, State::Tree& tree)
+{
+    tree.clear();
+    State::Tree::NodeExpander expander(0, tree,
+                                       SearchParamConst::child_min_count,
+                                       SearchParamConst::max_move_prior);
+    state.finish_in_tree();
+    LIBBOARDGAME_CHECK(state.gen_children(expander, 0.5));
+    expander.link_children(tree, tree.get_root());
+    vector<pair<Move, Float>> result;
+    for (auto& i : tree.get_root_children())
+        result.emplace_back(i.get_move(), i.get_move_prior());
+    return result;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+
+/** Test that the state generates the same children if gen_children() was
+    already called at an earlier position in the in-tree phase.
+    Needed for progressive widening, see
+    SearchParamConstDefault::widening_nu_children. */
+LIBBOARDGAME_TEST_CASE(pentobi_mcts_state_gen_children_again)
+{
+    auto bd = make_unique<Board>(Variant::trigon_2);
+    unsigned nu_threads = 1;
+    size_t memory = 10000;
+    auto search = make_unique<Search>(bd->get_variant(), nu_threads, memory);
+    Float max_count = 1;
+    size_t min_simulations = 1;
+    double max_time = 0;
+    CpuTimeSource time_source;
+    Move mv;
+    // Initializes the state for the position
+    LIBBOARDGAME_CHECK(search->search(mv, *bd, Color(0), max_count,
+                                      min_simulations, max_time,
+                                      time_source));
+    auto& state = search->get_state(0);
+    State::Tree tree(10000000, 1);
+    const unsigned nu_moves = 6;
+    vector<Move> moves;
+    vector<vector<pair<Move, Float>>> children;
+    for (unsigned i = 0; i <= nu_moves; ++i)
+    {
+        state.start_simulation(i);
+        for (auto mv : moves)
+            state.play_in_tree(mv);
+        children.push_back(gen_children(state, tree));
+        LIBBOARDGAME_CHECK(! children.back().empty());
+        moves.push_back(children.back()[0].first);
+    }
+    state.start_simulation(nu_moves + 1);
+    for (unsigned i = 0; i <= nu_moves; ++i)
+    {
+        if (i > 0)
+            state.play_in_tree(moves[i - 1]);
+        LIBBOARDGAME_CHECK(gen_children(state, tree) == children[i]);
+    }
+}
+
+//-----------------------------------------------------------------------------
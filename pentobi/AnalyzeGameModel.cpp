@@ -231,6 +231,7 @@ void AnalyzeGameModel::start(GameModel* gameModel, PlayerModel* playerModel,
     m_nuSimulations = static_cast<size_t>(nuSimulations);
     cancel();
     m_search = &playerModel->getSearch();
+    m_search->clear_abort();
     auto future = QtConcurrent::run([gameModel, this]() {
         m_analyzeGame.run(gameModel->getGame(), *this->m_search,
                           this->m_nuSimulations,
@@ -28,9 +28,13 @@ GtpEngine::GtpEngine(
     add("name", &GtpEngine::cmd_name);
     add("param", &GtpEngine::cmd_param);
     add("move_values", &GtpEngine::cmd_move_values);
+    add("read_tree", &GtpEngine::cmd_read_tree);
     add("save_tree", &GtpEngine::cmd_save_tree);
     add("selfplay", &GtpEngine::cmd_selfplay);
+    add("time_left", &GtpEngine::cmd_time_left);
+    add("time_settings", &GtpEngine::cmd_time_settings);
     add("version", &GtpEngine::cmd_version);
+    add("write_tree", &GtpEngine::cmd_write_tree);
 }
 
 GtpEngine::~GtpEngine() = default; // Non-inline to avoid GCC -Winline warning
@@ -64,6 +68,25 @@ void GtpEngine::cmd_name(Response& response)
     response.set("Pentobi");
 }
 
+/** Read a search tree written with write_tree.
+    A following genmove in the position of the tree or in a followup position
+    continues the search with the tree. */
+void GtpEngine::cmd_read_tree(Arguments args)
+{
+    ifstream in(args.get<string>(), ios::binary);
+    if (! in)
+        throw Failure("could not open file");
+    try
+    {
+        get_search().read_tree(in);
+    }
+    catch (const runtime_error& e)
+    {
+        throw Failure(e.what());
+    }
+}
+
+/** Dump the search tree of the last search in SGF format. */
 void GtpEngine::cmd_save_tree(Arguments args)
 {
     auto& search = get_search();
@@ -122,11 +145,13 @@ void GtpEngine::cmd_param(Arguments args, Response& response)
             << "avoid_symmetric_draw " << s.get_avoid_symmetric_draw() << '\n'
             << "exploration_constant " << s.get_exploration_constant() << '\n'
             << "fixed_simulations " << p.get_fixed_simulations() << '\n'
+            << "ponder " << p.get_ponder() << '\n'
             << "rave_child_max " << s.get_rave_child_max() << '\n'
             << "rave_parent_max " << s.get_rave_parent_max() << '\n'
             << "rave_weight " << s.get_rave_weight() << '\n'
             << "reuse_subtree " << s.get_reuse_subtree() << '\n'
-            << "use_book " << p.get_use_book() << '\n';
+            << "use_book " << p.get_use_book() << '\n'
+            << "use_transpositions " << s.get_use_transpositions() << '\n';
     else
     {
         args.check_size(2);
@@ -137,6 +162,8 @@ void GtpEngine::cmd_param(Arguments args, Response& response)
             s.set_exploration_constant(args.get<Float>(1));
         else if (name == "fixed_simulations")
             p.set_fixed_simulations(args.get<Float>(1));
+        else if (name == "ponder")
+            p.set_ponder(args.get<bool>(1));
         else if (name == "rave_child_max")
             s.set_rave_child_max(args.get<Float>(1));
         else if (name == "rave_parent_max")
@@ -147,6 +174,8 @@ void GtpEngine::cmd_param(Arguments args, Response& response)
             s.set_reuse_subtree(args.get<bool>(1));
         else if (name == "use_book")
             p.set_use_book(args.get<bool>(1));
+        else if (name == "use_transpositions")
+            s.set_use_transpositions(args.get<bool>(1));
         else
         {
             ostringstream msg;
@@ -156,6 +185,22 @@ void GtpEngine::cmd_param(Arguments args, Response& response)
     }
 }
 
+void GtpEngine::cmd_time_left(Arguments args)
+{
+    args.check_size(3);
+    get_mcts_player().set_time_left(get_color_arg(args, 0),
+                                    args.get_min<double>(1, 0),
+                                    args.get<unsigned>(2));
+}
+
+void GtpEngine::cmd_time_settings(Arguments args)
+{
+    args.check_size(3);
+    get_mcts_player().set_time_settings(args.get_min<double>(0, 0),
+                                        args.get_min<double>(1, 0),
+                                        args.get<unsigned>(2));
+}
+
 void GtpEngine::cmd_version(Response& response)
 {
     string version;
@@ -170,6 +215,19 @@ void GtpEngine::cmd_version(Response& response)
     response.set(version);
 }
 
+/** Write the search tree of the last search in a binary format.
+    See cmd_read_tree(). */
+void GtpEngine::cmd_write_tree(Arguments args)
+{
+    auto& search = get_search();
+    if (! search.get_last_history().is_valid())
+        throw Failure("no search tree");
+    ofstream out(args.get<string>(), ios::binary);
+    search.write_tree(out);
+    if (! out)
+        throw Failure("could not write file");
+}
+
 void GtpEngine::create_player(Variant variant, unsigned level,
                            const string& books_dir, unsigned nu_threads)
 {
@@ -34,9 +34,13 @@ public:
     void cmd_get_value(Response& response);
     void cmd_move_values(Response& response);
     static void cmd_name(Response& response);
+    void cmd_read_tree(Arguments args);
     void cmd_selfplay(Arguments args);
     void cmd_save_tree(Arguments args);
+    void cmd_time_left(Arguments args);
+    void cmd_time_settings(Arguments args);
     static void cmd_version(Response& response);
+    void cmd_write_tree(Arguments args);
 
     Player& get_mcts_player();
 
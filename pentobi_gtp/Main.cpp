@@ -9,11 +9,14 @@
 #include "libboardgame_base/Log.h"
 #include "libboardgame_base/Options.h"
 #include "libboardgame_base/RandomGenerator.h"
+#include "libboardgame_mcts/ThreadPool.h"
 
 using libboardgame_base::Options;
 using libboardgame_base::RandomGenerator;
 using libboardgame_gtp::Failure;
+using libboardgame_mcts::ThreadPool;
 using libpentobi_base::Board;
+using libpentobi_base::BoardConst;
 
 //-----------------------------------------------------------------------------
 
@@ -46,6 +49,7 @@ int main(int argc, char** argv)
     {
         vector<string> specs = {
             "book:",
+            "cachedir:",
             "config|c:",
             "color",
             "game|g:",
@@ -53,6 +57,7 @@ int main(int argc, char** argv)
             "level|l:",
             "nobook",
             "noresign",
+            "pinthreads",
             "quiet|q",
             "seed|r:",
             "showboard",
@@ -65,6 +70,7 @@ int main(int argc, char** argv)
             cout <<
                 "Usage: pentobi_gtp [options] [input files]\n"
                 "--book       load an external book file\n"
+                "--cachedir   directory for caching precomputed tables\n"
                 "--config,-c  set GTP config file\n"
                 "--color      colorize text output of boards\n"
                 "--game,-g    game variant (classic, classic_2, classic_3,\n"
@@ -76,6 +82,7 @@ int main(int argc, char** argv)
                 "             changes\n"
                 "--nobook     disable opening book\n"
                 "--noresign   disable resign\n"
+                "--pinthreads pin search threads to CPUs\n"
                 "--quiet,-q   do not print logging messages\n"
                 "--threads    number of threads in the search\n"
                 "--version,-v print version and exit\n";
@@ -98,6 +105,8 @@ int main(int argc, char** argv)
                 throw runtime_error("Number of threads must be greater zero.");
         }
         Board::color_output = opt.contains("color");
+        BoardConst::set_cache_dir(opt.get("cachedir", ""));
+        ThreadPool::get_global().set_pin_threads(opt.contains("pinthreads"));
         if (opt.contains("quiet"))
             libboardgame_base::disable_logging();
         if (opt.contains("seed"))